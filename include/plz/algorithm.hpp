@@ -0,0 +1,533 @@
+#ifndef __ALGORITHM_H__
+#define __ALGORITHM_H__
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+namespace plz
+{
+
+template <std::random_access_iterator Iterator, typename Compare = std::less<>>
+void parallel_sort(thread_pool& pool, Iterator first, Iterator last, Compare comp = {});
+
+template <std::random_access_iterator Iterator, typename Compare = std::less<>>
+void parallel_sort(Iterator first, Iterator last, Compare comp = {});
+
+template <std::random_access_iterator InputIterator, std::random_access_iterator OutputIterator, typename BinaryOp = std::plus<>>
+OutputIterator parallel_inclusive_scan(thread_pool& pool,
+  InputIterator first,
+  InputIterator last,
+  OutputIterator d_first,
+  BinaryOp op = {});
+
+template <std::random_access_iterator InputIterator, std::random_access_iterator OutputIterator, typename BinaryOp = std::plus<>>
+OutputIterator parallel_inclusive_scan(InputIterator first,
+  InputIterator last,
+  OutputIterator d_first,
+  BinaryOp op = {});
+
+template <std::random_access_iterator InputIterator, std::random_access_iterator OutputIterator, typename T, typename BinaryOp = std::plus<>>
+OutputIterator parallel_exclusive_scan(thread_pool& pool,
+  InputIterator first,
+  InputIterator last,
+  OutputIterator d_first,
+  T init,
+  BinaryOp op = {});
+
+template <std::random_access_iterator InputIterator, std::random_access_iterator OutputIterator, typename T, typename BinaryOp = std::plus<>>
+OutputIterator parallel_exclusive_scan(InputIterator first,
+  InputIterator last,
+  OutputIterator d_first,
+  T init,
+  BinaryOp op = {});
+
+namespace detail
+{
+
+// ranges shorter than this are sorted sequentially
+inline constexpr size_t g_parallel_sort_cutoff = size_t(1) << 14;
+
+// ranges shorter than this are scanned sequentially
+inline constexpr size_t g_parallel_scan_cutoff = size_t(1) << 14;
+
+// number of samples taken per bucket to choose the sample sort splitters
+inline constexpr size_t g_sample_sort_oversampling = 32;
+
+// Runs func(i) for every i in [0, count) on `pool`, the calling thread runs
+// func(0) itself. Returns once all of them are done and rethrows the first
+// exception thrown by one of them.
+//
+// The tasks reference func and whatever it captures by reference, so this
+// never returns before every posted task finished, not even when posting
+// one of them throws.
+//
+// The calling thread blocks, so it should not be a worker of `pool`.
+template <typename Func>
+void parallel_for_each_index(thread_pool& pool, size_t count, Func&& func)
+{
+  std::vector<future<void>> futures;
+  std::exception_ptr exception;
+
+  try
+  {
+    futures.reserve(count);
+
+    for(size_t i = 1; i < count; ++i)
+    {
+      futures.push_back(pool.run(
+        [&func, i]()
+        {
+          func(i);
+        }));
+    }
+
+    if(count > 0)
+    {
+      func(0);
+    }
+  }
+  catch(...)
+  {
+    exception = std::current_exception();
+  }
+
+  for(auto& future : futures)
+  {
+    try
+    {
+      future.get();
+    }
+    catch(...)
+    {
+      if(!exception)
+      {
+        exception = std::current_exception();
+      }
+    }
+  }
+
+  if(exception)
+  {
+    std::rethrow_exception(exception);
+  }
+}
+
+// Bounds of the i-th of `count` blocks that split [0, size) evenly
+inline std::pair<size_t, size_t> block_bounds(size_t size, size_t count, size_t i)
+{
+  return { size * i / count, size * (i + 1) / count };
+}
+
+template <typename T, typename Compare>
+constexpr bool is_radix_sortable_v = std::is_integral_v<T> && !std::is_same_v<T, bool> &&
+  (std::is_same_v<Compare, std::less<>> || std::is_same_v<Compare, std::less<T>>);
+
+// Maps an integral value on an unsigned key that has the same ordering
+template <typename T>
+auto radix_key(T value)
+{
+  using key_type = std::make_unsigned_t<T>;
+
+  if constexpr(std::is_signed_v<T>)
+  {
+    return static_cast<key_type>(
+      static_cast<key_type>(value) ^ (key_type(1) << (std::numeric_limits<key_type>::digits - 1)));
+  }
+  else
+  {
+    return static_cast<key_type>(value);
+  }
+}
+
+// Parallel LSD radix sort on 8 bits digits. Every pass builds a histogram per
+// block, computes the scatter offset of each (digit, block) pair and scatters
+// the blocks in parallel, ping-ponging between the range and a buffer.
+template <typename Iterator>
+void parallel_radix_sort(thread_pool& pool, Iterator first, Iterator last, size_t blocks_count)
+{
+  using value_type = std::iter_value_t<Iterator>;
+
+  constexpr size_t digits_count = 256;
+  constexpr size_t passes_count = sizeof(value_type);
+
+  const size_t size = static_cast<size_t>(last - first);
+
+  std::vector<value_type> buffer(size);
+  std::vector<std::array<size_t, digits_count>> offsets(blocks_count);
+
+  bool in_buffer = false;
+
+  auto input_at = [&](size_t i) -> value_type&
+  {
+    return in_buffer ? buffer[i] : first[i];
+  };
+
+  auto output_at = [&](size_t i) -> value_type&
+  {
+    return in_buffer ? first[i] : buffer[i];
+  };
+
+  for(size_t pass = 0; pass < passes_count; ++pass)
+  {
+    const auto shift = pass * 8;
+
+    auto digit_of = [shift](const value_type& value)
+    {
+      return static_cast<size_t>((radix_key(value) >> shift) & 0xff);
+    };
+
+    parallel_for_each_index(pool,
+      blocks_count,
+      [&](size_t block)
+      {
+        auto [begin, end] = block_bounds(size, blocks_count, block);
+        auto& histogram   = offsets[block];
+        histogram.fill(0);
+
+        for(size_t i = begin; i < end; ++i)
+        {
+          histogram[digit_of(input_at(i))]++;
+        }
+      });
+
+    // all the values share this digit, the pass would not move anything
+    bool skip_pass = false;
+    size_t offset  = 0;
+
+    for(size_t digit = 0; digit < digits_count; ++digit)
+    {
+      size_t digit_count = 0;
+
+      for(size_t block = 0; block < blocks_count; ++block)
+      {
+        auto count            = offsets[block][digit];
+        offsets[block][digit] = offset;
+        offset += count;
+        digit_count += count;
+      }
+
+      skip_pass = skip_pass || (digit_count == size);
+    }
+
+    if(skip_pass)
+    {
+      continue;
+    }
+
+    parallel_for_each_index(pool,
+      blocks_count,
+      [&](size_t block)
+      {
+        auto [begin, end] = block_bounds(size, blocks_count, block);
+        auto& block_offsets = offsets[block];
+
+        for(size_t i = begin; i < end; ++i)
+        {
+          auto& value                                = input_at(i);
+          output_at(block_offsets[digit_of(value)]++) = value;
+        }
+      });
+
+    in_buffer = !in_buffer;
+  }
+
+  if(in_buffer)
+  {
+    std::copy(buffer.begin(), buffer.end(), first);
+  }
+}
+
+// Parallel sample sort: the splitters picked from a sorted sample define one
+// bucket per block, every block counts then scatters its values in the buckets,
+// and the buckets are sorted independently.
+template <typename Iterator, typename Compare>
+void parallel_sample_sort(thread_pool& pool,
+  Iterator first,
+  Iterator last,
+  Compare comp,
+  size_t blocks_count)
+{
+  using value_type = std::iter_value_t<Iterator>;
+
+  const size_t size          = static_cast<size_t>(last - first);
+  const size_t buckets_count = blocks_count;
+
+  std::vector<value_type> sample;
+  const size_t sample_size = buckets_count * g_sample_sort_oversampling;
+  sample.reserve(sample_size);
+
+  for(size_t i = 0; i < sample_size; ++i)
+  {
+    sample.push_back(first[i * size / sample_size]);
+  }
+
+  std::sort(sample.begin(), sample.end(), comp);
+
+  std::vector<value_type> splitters;
+  splitters.reserve(buckets_count - 1);
+
+  for(size_t i = 1; i < buckets_count; ++i)
+  {
+    splitters.push_back(sample[i * g_sample_sort_oversampling]);
+  }
+
+  auto bucket_of = [&splitters, &comp](const value_type& value)
+  {
+    return static_cast<size_t>(
+      std::upper_bound(splitters.begin(), splitters.end(), value, comp) - splitters.begin());
+  };
+
+  // offsets[block][bucket]
+  std::vector<std::vector<size_t>> offsets(blocks_count, std::vector<size_t>(buckets_count, 0));
+
+  parallel_for_each_index(pool,
+    blocks_count,
+    [&](size_t block)
+    {
+      auto [begin, end] = block_bounds(size, blocks_count, block);
+
+      for(size_t i = begin; i < end; ++i)
+      {
+        offsets[block][bucket_of(first[i])]++;
+      }
+    });
+
+  std::vector<size_t> bucket_begins(buckets_count + 1, 0);
+  size_t offset = 0;
+
+  for(size_t bucket = 0; bucket < buckets_count; ++bucket)
+  {
+    bucket_begins[bucket] = offset;
+
+    for(size_t block = 0; block < blocks_count; ++block)
+    {
+      auto count             = offsets[block][bucket];
+      offsets[block][bucket] = offset;
+      offset += count;
+    }
+  }
+
+  bucket_begins[buckets_count] = size;
+
+  std::vector<value_type> buffer(size);
+
+  parallel_for_each_index(pool,
+    blocks_count,
+    [&](size_t block)
+    {
+      auto [begin, end] = block_bounds(size, blocks_count, block);
+      auto& block_offsets = offsets[block];
+
+      for(size_t i = begin; i < end; ++i)
+      {
+        buffer[block_offsets[bucket_of(first[i])]++] = std::move(first[i]);
+      }
+    });
+
+  parallel_for_each_index(pool,
+    buckets_count,
+    [&](size_t bucket)
+    {
+      auto begin = buffer.begin() + bucket_begins[bucket];
+      auto end   = buffer.begin() + bucket_begins[bucket + 1];
+
+      std::sort(begin, end, comp);
+      std::move(begin, end, first + bucket_begins[bucket]);
+    });
+}
+
+// Two pass blocked scan: every block reduces its values in parallel, the block
+// reductions are scanned sequentially, then every block scans its values
+// starting from the reduction of the blocks before it. `init` is the value the
+// scan starts from (exclusive scan) or nullopt (inclusive scan).
+template <typename T, typename InputIterator, typename OutputIterator, typename BinaryOp>
+OutputIterator parallel_scan(thread_pool& pool,
+  InputIterator first,
+  InputIterator last,
+  OutputIterator d_first,
+  std::optional<T> init,
+  BinaryOp op)
+{
+  const size_t size         = static_cast<size_t>(last - first);
+  const size_t blocks_count = std::min(pool.get_thread_count(), size / g_parallel_scan_cutoff);
+
+  if(blocks_count < 2)
+  {
+    if(init)
+    {
+      return std::exclusive_scan(first, last, d_first, std::move(*init), op);
+    }
+
+    return std::inclusive_scan(first, last, d_first, op);
+  }
+
+  // the last block reduction is never used as a prefix
+  std::vector<std::optional<T>> prefixes(blocks_count);
+
+  parallel_for_each_index(pool,
+    blocks_count - 1,
+    [&](size_t block)
+    {
+      auto [begin, end] = block_bounds(size, blocks_count, block);
+
+      T reduction = first[begin];
+      for(size_t i = begin + 1; i < end; ++i)
+      {
+        reduction = op(std::move(reduction), first[i]);
+      }
+
+      prefixes[block] = std::move(reduction);
+    });
+
+  // prefixes[block] becomes the reduction of everything before the block
+  std::optional<T> prefix = std::move(init);
+  for(size_t block = 0; block < blocks_count; ++block)
+  {
+    auto reduction = std::move(prefixes[block]);
+    prefixes[block] = prefix;
+
+    if(reduction)
+    {
+      prefix = prefix ? op(std::move(*prefix), std::move(*reduction)) : std::move(*reduction);
+    }
+  }
+
+  const bool exclusive = static_cast<bool>(prefixes[0]);
+
+  parallel_for_each_index(pool,
+    blocks_count,
+    [&](size_t block)
+    {
+      auto [begin, end] = block_bounds(size, blocks_count, block);
+
+      std::optional<T> accumulator = prefixes[block];
+
+      for(size_t i = begin; i < end; ++i)
+      {
+        // read the input before writing the output so that in place scans work
+        T value = accumulator ? op(*accumulator, first[i]) : T(first[i]);
+
+        if(exclusive)
+        {
+          d_first[i] = std::move(*accumulator);
+        }
+        else
+        {
+          d_first[i] = value;
+        }
+
+        accumulator = std::move(value);
+      }
+    });
+
+  return d_first + size;
+}
+
+} // namespace detail
+
+/**
+ * Sorts [first, last) using the workers of `pool`.
+ *
+ * Integral values compared with std::less are sorted with a parallel radix
+ * sort, other types with a parallel sample sort. Ranges shorter than a few
+ * thousands elements, pools with a single thread and value types that are not
+ * default constructible fall back to std::sort. Like std::sort, the sort is
+ * not stable.
+ *
+ * The calling thread takes part in the sort and blocks until it is done, so it
+ * should not be a worker of `pool`.
+ */
+template <std::random_access_iterator Iterator, typename Compare>
+void parallel_sort(thread_pool& pool, Iterator first, Iterator last, Compare comp)
+{
+  using value_type = std::iter_value_t<Iterator>;
+
+  const size_t size         = static_cast<size_t>(last - first);
+  const size_t blocks_count = std::min(pool.get_thread_count(), size / detail::g_parallel_sort_cutoff);
+
+  if(blocks_count < 2 || !std::is_default_constructible_v<value_type>)
+  {
+    std::sort(first, last, comp);
+  }
+  else if constexpr(detail::is_radix_sortable_v<value_type, Compare>)
+  {
+    detail::parallel_radix_sort(pool, first, last, blocks_count);
+  }
+  else if constexpr(std::is_default_constructible_v<value_type>)
+  {
+    detail::parallel_sample_sort(pool, first, last, comp, blocks_count);
+  }
+}
+
+template <std::random_access_iterator Iterator, typename Compare>
+void parallel_sort(Iterator first, Iterator last, Compare comp)
+{
+  parallel_sort(thread_pool::global_instance(), first, last, comp);
+}
+
+/**
+ * Parallel equivalent of std::inclusive_scan using the workers of `pool`.
+ *
+ * `op` should be associative, the order in which the partial results are
+ * combined is unspecified. [first, last) and the output range may be the same.
+ */
+template <std::random_access_iterator InputIterator, std::random_access_iterator OutputIterator, typename BinaryOp>
+OutputIterator parallel_inclusive_scan(thread_pool& pool,
+  InputIterator first,
+  InputIterator last,
+  OutputIterator d_first,
+  BinaryOp op)
+{
+  return detail::parallel_scan<std::iter_value_t<InputIterator>>(
+    pool, first, last, d_first, std::nullopt, op);
+}
+
+template <std::random_access_iterator InputIterator, std::random_access_iterator OutputIterator, typename BinaryOp>
+OutputIterator
+parallel_inclusive_scan(InputIterator first, InputIterator last, OutputIterator d_first, BinaryOp op)
+{
+  return parallel_inclusive_scan(thread_pool::global_instance(), first, last, d_first, op);
+}
+
+/**
+ * Parallel equivalent of std::exclusive_scan using the workers of `pool`.
+ *
+ * `op` should be associative, the order in which the partial results are
+ * combined is unspecified. [first, last) and the output range may be the same.
+ */
+template <std::random_access_iterator InputIterator, std::random_access_iterator OutputIterator, typename T, typename BinaryOp>
+OutputIterator parallel_exclusive_scan(thread_pool& pool,
+  InputIterator first,
+  InputIterator last,
+  OutputIterator d_first,
+  T init,
+  BinaryOp op)
+{
+  return detail::parallel_scan<T>(pool, first, last, d_first, std::move(init), op);
+}
+
+template <std::random_access_iterator InputIterator, std::random_access_iterator OutputIterator, typename T, typename BinaryOp>
+OutputIterator parallel_exclusive_scan(InputIterator first,
+  InputIterator last,
+  OutputIterator d_first,
+  T init,
+  BinaryOp op)
+{
+  return parallel_exclusive_scan(
+    thread_pool::global_instance(), first, last, d_first, std::move(init), op);
+}
+
+} // namespace plz
+
+#endif // __ALGORITHM_H__
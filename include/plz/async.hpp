@@ -0,0 +1,293 @@
+#ifndef __ASYNC_H__
+#define __ASYNC_H__
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#include "future.hpp"
+#include "thread_pool.hpp"
+
+namespace plz
+{
+
+template <typename T>
+class async_task;
+
+namespace detail
+{
+
+template <typename T>
+struct async_task_promise_base
+{
+  promise<T> m_promise = make_promise<T>();
+
+  template <typename U>
+  void return_value(U&& value)
+  {
+    m_promise.set_result(std::forward<U>(value));
+  }
+};
+
+template <>
+struct async_task_promise_base<void>
+{
+  promise<void> m_promise = make_promise<void>();
+
+  void return_void()
+  {
+    m_promise.set_ready();
+  }
+};
+
+} // namespace detail
+
+/**
+ * Coroutine type for asynchronous code that completes a plz::future.
+ *
+ * The coroutine starts right away on the calling thread and runs until its
+ * first suspension, then continues wherever it is resumed (a thread_pool
+ * worker for the awaitables of this library). Its frame is freed when it
+ * completes, the result or exception is delivered through get_future().
+ *
+ * ```
+ * plz::async_task<size_t> count_lines(plz::sink<buffer>& lines)
+ * {
+ *   size_t count = 0;
+ *   while(true)
+ *   {
+ *     auto batch = co_await plz::next_batch(lines);
+ *     if(batch.empty()) co_return count;
+ *     count += batch.size();
+ *   }
+ * }
+ * ```
+ */
+template <typename T = void>
+class async_task
+{
+  public:
+  struct promise_type : detail::async_task_promise_base<T>
+  {
+    async_task get_return_object()
+    {
+      return async_task(this->m_promise.get_future());
+    }
+
+    std::suspend_never initial_suspend() noexcept
+    {
+      return {};
+    }
+
+    std::suspend_never final_suspend() noexcept
+    {
+      return {};
+    }
+
+    void unhandled_exception()
+    {
+      this->m_promise.set_exception(std::current_exception());
+    }
+  };
+
+  future<T> get_future() const
+  {
+    return m_future;
+  }
+
+  private:
+  explicit async_task(future<T> future) : m_future{ std::move(future) }
+  {
+  }
+
+  future<T> m_future;
+};
+
+/**
+ * Asynchronous generator coroutine: the body produces values with `co_yield`
+ * and may `co_await` between them, the consumer pulls them with
+ * `co_await generator.next()`, which returns std::nullopt once the body
+ * returned. The body runs lazily, only while a consumer awaits next(), and
+ * exceptions it throws are rethrown by next().
+ *
+ * ```
+ * plz::async_generator<int> numbers(int count)
+ * {
+ *   for(int i = 0; i < count; ++i)
+ *     co_yield i;
+ * }
+ * ```
+ */
+template <typename T>
+class async_generator
+{
+  public:
+  struct promise_type
+  {
+    std::optional<T> m_value;
+    std::exception_ptr m_exception;
+    std::coroutine_handle<> m_consumer;
+
+    // gives the control back to the consumer awaiting next()
+    struct yield_awaiter
+    {
+      bool await_ready() noexcept
+      {
+        return false;
+      }
+
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+      {
+        return handle.promise().m_consumer;
+      }
+
+      void await_resume() noexcept
+      {
+      }
+    };
+
+    async_generator get_return_object()
+    {
+      return async_generator(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    std::suspend_always initial_suspend() noexcept
+    {
+      return {};
+    }
+
+    yield_awaiter final_suspend() noexcept
+    {
+      return {};
+    }
+
+    template <typename U>
+      requires std::constructible_from<T, U&&>
+    yield_awaiter yield_value(U&& value)
+    {
+      m_value.emplace(std::forward<U>(value));
+      return {};
+    }
+
+    void return_void()
+    {
+    }
+
+    void unhandled_exception()
+    {
+      m_exception = std::current_exception();
+    }
+  };
+
+  using handle_type = std::coroutine_handle<promise_type>;
+
+  struct next_awaiter
+  {
+    handle_type m_generator;
+
+    bool await_ready() noexcept
+    {
+      return !m_generator || m_generator.done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) noexcept
+    {
+      auto& promise      = m_generator.promise();
+      promise.m_consumer = consumer;
+      promise.m_value.reset();
+      return m_generator;
+    }
+
+    std::optional<T> await_resume()
+    {
+      if(!m_generator)
+      {
+        return std::nullopt;
+      }
+
+      auto& promise = m_generator.promise();
+
+      if(promise.m_exception)
+      {
+        std::rethrow_exception(std::exchange(promise.m_exception, nullptr));
+      }
+
+      if(m_generator.done())
+      {
+        return std::nullopt;
+      }
+
+      return std::move(promise.m_value);
+    }
+  };
+
+  async_generator(async_generator&& other) noexcept
+    : m_handle{ std::exchange(other.m_handle, nullptr) }
+  {
+  }
+
+  async_generator& operator=(async_generator&& other) noexcept
+  {
+    std::swap(m_handle, other.m_handle);
+    return *this;
+  }
+
+  async_generator(const async_generator&)            = delete;
+  async_generator& operator=(const async_generator&) = delete;
+
+  ~async_generator()
+  {
+    if(m_handle)
+    {
+      m_handle.destroy();
+    }
+  }
+
+  next_awaiter next()
+  {
+    return { m_handle };
+  }
+
+  private:
+  explicit async_generator(handle_type handle) : m_handle{ handle }
+  {
+  }
+
+  handle_type m_handle;
+};
+
+/**
+ * Awaitable that resumes the awaiting coroutine on a worker of `pool`.
+ */
+inline auto resume_on(thread_pool& pool)
+{
+  struct awaiter
+  {
+    thread_pool& m_pool;
+
+    bool await_ready() noexcept
+    {
+      return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+      m_pool.run(thread_pool::task_variant(thread_pool::task_type(
+        [handle]
+        {
+          handle.resume();
+        })));
+    }
+
+    void await_resume() noexcept
+    {
+    }
+  };
+
+  return awaiter{ pool };
+}
+
+} // namespace plz
+
+#endif // __ASYNC_H__
@@ -0,0 +1,201 @@
+#ifndef __ASYNC_CHANNEL_H__
+#define __ASYNC_CHANNEL_H__
+
+#include <coroutine>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "plz/async.hpp"
+#include "plz/thread_pool.hpp"
+
+#include "channel.hpp"
+
+namespace plz
+{
+
+namespace detail
+{
+
+// Waiter callback that resumes a suspended coroutine on a worker of `pool`
+inline plz::callable<void()> resume_on_pool(std::coroutine_handle<> handle, thread_pool& pool)
+{
+  return plz::callable<void()>(
+    [handle, &pool]
+    {
+      pool.run(thread_pool::task_variant(thread_pool::task_type(
+        [handle]
+        {
+          handle.resume();
+        })));
+    });
+}
+
+} // namespace detail
+
+/**
+ * Awaitable that returns up to `max_count` values read from `input`. The
+ * awaiting coroutine is suspended, without holding any thread, while the sink
+ * is empty and is resumed on a worker of `pool` when values are written. An
+ * empty batch means the channel is closed and the sink drained.
+ *
+ * C++20 has no `for co_await`, the loop is written as:
+ * ```
+ * while(true)
+ * {
+ *   auto batch = co_await plz::next_batch(sink);
+ *   if(batch.empty()) break;
+ *   process(batch);
+ * }
+ * ```
+ */
+template <circular_buffer_ptr BufferPointer>
+auto next_batch(sink<BufferPointer>& input,
+  size_t max_count  = sink<BufferPointer>::CAPACITY,
+  thread_pool& pool = thread_pool::global_instance())
+{
+  struct awaiter
+  {
+    plz::sink<BufferPointer>& m_sink;
+    size_t m_max_count;
+    thread_pool& m_pool;
+    std::vector<typename plz::sink<BufferPointer>::value_type> m_batch{};
+
+    // The closed flag is read first: values written before the close are then
+    // visible to the read
+    bool try_read()
+    {
+      auto closed = m_sink.is_closed();
+      m_batch     = m_sink.read(m_max_count);
+      return !m_batch.empty() || closed;
+    }
+
+    bool await_ready()
+    {
+      return try_read();
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+      wait(handle);
+    }
+
+    std::vector<typename plz::sink<BufferPointer>::value_type> await_resume()
+    {
+      return std::move(m_batch);
+    }
+
+    // The batch is read on the worker before the coroutine is resumed: a wake
+    // up that finds nothing to read, e.g. because another coroutine awaiting
+    // the same sink read it first, waits again instead of returning an empty
+    // batch for an open channel
+    void wait(std::coroutine_handle<> handle)
+    {
+      m_sink.wait_for_data(plz::callable<void()>(
+        [this, handle]
+        {
+          m_pool.run(thread_pool::task_variant(thread_pool::task_type(
+            [this, handle]
+            {
+              if(try_read())
+              {
+                handle.resume();
+              }
+              else
+              {
+                wait(handle);
+              }
+            })));
+        }));
+    }
+  };
+
+  return awaiter{ input, max_count, pool };
+}
+
+/**
+ * Awaitable that writes `value` to `output` once a value can be written
+ * without overwriting values a sink of the channel did not read yet. The
+ * awaiting coroutine is suspended, without holding any thread, while the
+ * channel is full and is resumed on a worker of `pool` when a sink reads.
+ *
+ * The backpressure is exact for a single producer: concurrent producers may
+ * take the freed space between the wake up and the write.
+ */
+template <circular_buffer_ptr BufferPointer>
+auto async_put(source<BufferPointer>& output,
+  typename source<BufferPointer>::value_type value,
+  thread_pool& pool = thread_pool::global_instance())
+{
+  struct awaiter
+  {
+    plz::source<BufferPointer>& m_source;
+    typename plz::source<BufferPointer>::value_type m_value;
+    thread_pool& m_pool;
+
+    bool await_ready()
+    {
+      return m_source.get_free_space() > 0;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+      m_source.wait_for_space(detail::resume_on_pool(handle, m_pool));
+    }
+
+    void await_resume()
+    {
+      m_source.put(std::move(m_value));
+    }
+  };
+
+  return awaiter{ output, std::move(value), pool };
+}
+
+namespace detail
+{
+
+template <typename T, circular_buffer_ptr BufferPointer>
+async_task<void>
+pipe_to_task(async_generator<T> generator, source<BufferPointer>& output, thread_pool& pool)
+{
+  try
+  {
+    while(auto value = co_await generator.next())
+    {
+      co_await async_put(output, std::move(*value), pool);
+    }
+  }
+  catch(...)
+  {
+    output.close();
+    throw;
+  }
+
+  output.close();
+}
+
+} // namespace detail
+
+/**
+ * Drains `generator` into `output` with backpressure (see async_put) and
+ * closes the source when the generator is done or throws. The source must
+ * outlive the returned future.
+ *
+ * ```
+ * plz::async_generator<record> parse(std::string path);
+ *
+ * auto done = plz::pipe_to(parse("data.csv"), source);
+ * ```
+ */
+template <typename T, circular_buffer_ptr BufferPointer>
+future<void> pipe_to(async_generator<T> generator,
+  source<BufferPointer>& output,
+  thread_pool& pool = thread_pool::global_instance())
+{
+  return detail::pipe_to_task(std::move(generator), output, pool).get_future();
+}
+
+} // namespace plz
+
+#endif // __ASYNC_CHANNEL_H__
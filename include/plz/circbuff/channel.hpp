@@ -7,11 +7,14 @@
 #include <cstddef>
 #include <cstring>
 #include <functional>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <utility>
 #include <vector>
 
 #include "plz/help/array_traits.hpp"
+#include "plz/help/callable.hpp"
 #include "plz/thread_pool.hpp"
 
 #include "concepts.hpp"
@@ -81,6 +84,22 @@ class channel
   buffer_ptr_type m_buffer;
   writer<buffer_ptr_type> m_writer;
 
+  // sinks alive on this channel, the slowest one bounds the free space
+  mutable std::mutex m_sinks_mutex;
+  std::vector<const sink<buffer_ptr_type>*> m_sinks;
+
+  // callbacks waiting for data to read or space to write, see
+  // wait_for_data/wait_for_space
+  using waiter = std::pair<size_t, plz::callable<void()>>;
+
+  std::mutex m_waiters_mutex;
+  std::vector<waiter> m_data_waiters;
+  std::vector<waiter> m_space_waiters;
+  size_t m_waiter_id_counter{ 0 };
+  std::atomic<size_t> m_waiters_count{ 0 };
+
+  std::atomic<bool> m_closed{ false };
+
   template <size_t SINKS_COUNT>
   friend constexpr auto make_spmc_channel(circular_buffer_ptr auto buffer_ptr)
     -> std::pair<source<decltype(buffer_ptr)>, std::array<sink<decltype(buffer_ptr)>, SINKS_COUNT>>;
@@ -100,6 +119,98 @@ class channel
     : m_buffer{ std::move(buffer_ptr) }, m_writer{ m_buffer }
   {
   }
+
+  void add_sink(const sink<buffer_ptr_type>* sink)
+  {
+    std::lock_guard lock(m_sinks_mutex);
+    m_sinks.push_back(sink);
+  }
+
+  void remove_sink(const sink<buffer_ptr_type>* sink)
+  {
+    std::lock_guard lock(m_sinks_mutex);
+    std::erase(m_sinks, sink);
+  }
+
+  // Swaps the registered sink in one step, get_free_space never sees the
+  // channel without it
+  void replace_sink(const sink<buffer_ptr_type>* old_sink, const sink<buffer_ptr_type>* new_sink)
+  {
+    std::lock_guard lock(m_sinks_mutex);
+    std::ranges::replace(m_sinks, old_sink, new_sink);
+  }
+
+  // Number of values that can be written before overwriting values the
+  // slowest sink did not read yet. Unbounded when there is no sink.
+  size_t get_free_space() const;
+
+  size_t add_data_waiter(plz::callable<void()> waiter)
+  {
+    return add_waiter(m_data_waiters, std::move(waiter));
+  }
+
+  size_t add_space_waiter(plz::callable<void()> waiter)
+  {
+    return add_waiter(m_space_waiters, std::move(waiter));
+  }
+
+  bool remove_data_waiter(size_t id)
+  {
+    return remove_waiter(m_data_waiters, id);
+  }
+
+  void notify_data()
+  {
+    notify_waiters(m_data_waiters);
+  }
+
+  void notify_space()
+  {
+    notify_waiters(m_space_waiters);
+  }
+
+  private:
+  size_t add_waiter(std::vector<waiter>& waiters, plz::callable<void()>&& func)
+  {
+    std::lock_guard lock(m_waiters_mutex);
+    auto id = m_waiter_id_counter++;
+    waiters.push_back({ id, std::move(func) });
+    m_waiters_count++;
+    return id;
+  }
+
+  bool remove_waiter(std::vector<waiter>& waiters, size_t id)
+  {
+    std::lock_guard lock(m_waiters_mutex);
+    auto removed = std::erase_if(waiters,
+      [id](const waiter& entry)
+      {
+        return entry.first == id;
+      });
+    m_waiters_count -= removed;
+    return removed > 0;
+  }
+
+  // Wakes all the waiters of the list. Costs an atomic load when nobody waits.
+  void notify_waiters(std::vector<waiter>& waiters)
+  {
+    if(m_waiters_count.load() == 0)
+    {
+      return;
+    }
+
+    std::vector<waiter> woken;
+    {
+      std::lock_guard lock(m_waiters_mutex);
+      woken.swap(waiters);
+      m_waiters_count -= woken.size();
+    }
+
+    for(auto& [_, func] : woken)
+    {
+      func();
+    }
+  }
 };
 
 } // namespace detail
@@ -163,6 +274,46 @@ class source
     return m_channel->m_buffer->size();
   }
 
+  /**
+   * Number of values that can be written before overwriting values a sink of
+   * the channel did not read yet.
+   */
+  size_t get_free_space() const
+  {
+    return m_channel->get_free_space();
+  }
+
+  /**
+   * Marks the channel as closed: the sinks waiting for data are woken up and
+   * plz::next_batch returns an empty batch once a sink is drained.
+   */
+  void close()
+  {
+    m_channel->m_closed = true;
+    m_channel->notify_data();
+  }
+
+  bool is_closed() const
+  {
+    return m_channel->m_closed;
+  }
+
+  /**
+   * Calls `waiter` once, from the thread that reads from the channel, after a
+   * sink of the channel read values. Used to suspend producers on a full
+   * channel, see plz::wait_for_space.
+   */
+  void wait_for_space(plz::callable<void()> waiter)
+  {
+    m_channel->add_space_waiter(std::move(waiter));
+
+    // space may have been freed before the waiter was registered
+    if(get_free_space() > 0)
+    {
+      m_channel->notify_space();
+    }
+  }
+
   void put(const value_type& value)
   {
     m_channel->m_writer.put(value);
@@ -170,6 +321,31 @@ class source
     {
       func(1);
     }
+
+    m_channel->notify_data();
+  }
+
+  /**
+   * Constructs a value from `args` directly in the ring, unless the channel has
+   * no free space (see get_free_space), in which case it returns false.
+   */
+  template <typename... Args>
+    requires std::constructible_from<value_type, Args&&...>
+  bool try_emplace(Args&&... args)
+  {
+    if(get_free_space() == 0)
+    {
+      return false;
+    }
+
+    m_channel->m_writer.emplace(std::forward<Args>(args)...);
+    for(auto& [_, func] : m_notif_funcs)
+    {
+      func(1);
+    }
+
+    m_channel->notify_data();
+    return true;
   }
 
   void write(const value_type* values, size_t count)
@@ -180,6 +356,8 @@ class source
     {
       func(count);
     }
+
+    m_channel->notify_data();
   };
 
   template <typename Func>
@@ -189,11 +367,13 @@ class source
   {
     auto size_written = m_channel->m_writer.write_using(std::forward<Func>(func), count);
 
-    for(auto& func : m_notif_funcs)
+    for(auto& [_, notify_func] : m_notif_funcs)
     {
-      func(size_written);
+      notify_func(size_written);
     }
 
+    m_channel->notify_data();
+
     return size_written;
   };
 
@@ -230,10 +410,65 @@ class sink
   std::shared_ptr<detail::channel<buffer_pointer_type>> m_channel;
   reader<buffer_pointer_type> m_reader;
 
+  friend class detail::channel<buffer_pointer_type>;
+
   public:
   sink(std::shared_ptr<detail::channel<buffer_pointer_type>> channel)
     : m_channel{ std::move(channel) }, m_reader{ m_channel->m_buffer }
   {
+    m_channel->add_sink(this);
+  }
+
+  /**
+   * A copy is another reader of the channel, starting where `other` is: until
+   * it is read or destroyed, it holds back the free space of the channel like
+   * any other sink.
+   */
+  sink(const sink& other) : m_channel{ other.m_channel }, m_reader{ other.m_reader }
+  {
+    if(m_channel)
+    {
+      m_channel->add_sink(this);
+    }
+  }
+
+  // the moved-from sink is detached from the channel, it would otherwise keep
+  // its read index, and the free space, where it was
+  sink(sink&& other) : m_channel{ std::move(other.m_channel) }, m_reader{ std::move(other.m_reader) }
+  {
+    if(m_channel)
+    {
+      m_channel->replace_sink(&other, this);
+    }
+  }
+
+  sink& operator=(const sink& other)
+  {
+    if(this != &other)
+    {
+      set_channel(other.m_channel);
+      m_reader = other.m_reader;
+    }
+    return *this;
+  }
+
+  sink& operator=(sink&& other)
+  {
+    if(this != &other)
+    {
+      set_channel(other.m_channel);
+      m_reader = std::move(other.m_reader);
+      other.set_channel(nullptr);
+    }
+    return *this;
+  }
+
+  ~sink()
+  {
+    if(m_channel)
+    {
+      m_channel->remove_sink(this);
+    }
   }
 
   sink clone() const
@@ -246,6 +481,39 @@ class sink
     m_reader.reset();
   }
 
+  bool is_closed() const
+  {
+    return m_channel->m_closed;
+  }
+
+  /**
+   * Calls `waiter` once, from the thread that writes to the channel, when
+   * values are written or the channel is closed. Used to suspend consumers on
+   * an empty channel, see plz::next_batch. Returns an id for
+   * cancel_wait_for_data.
+   */
+  size_t wait_for_data(plz::callable<void()> waiter)
+  {
+    auto id = m_channel->add_data_waiter(std::move(waiter));
+
+    // values may have been written before the waiter was registered
+    if(get_available_data_size() > 0 || is_closed())
+    {
+      m_channel->notify_data();
+    }
+
+    return id;
+  }
+
+  /**
+   * Unregisters a waiter of wait_for_data that was not called yet. Returns
+   * false if it was already called (or is being called).
+   */
+  bool cancel_wait_for_data(size_t id)
+  {
+    return m_channel->remove_data_waiter(id);
+  }
+
   size_t get_buffer_capacity() const
   {
     return m_channel->m_buffer->size();
@@ -259,7 +527,9 @@ class sink
 
   value_type get()
   {
-    return m_reader.get();
+    auto value = m_reader.get();
+    m_channel->notify_space();
+    return value;
   }
 
   const value_type& peek() const
@@ -276,6 +546,7 @@ class sink
   {
     auto read_count = std::min(get_available_data_size(), count);
     m_reader.read(values, read_count);
+    m_channel->notify_space();
     return read_count;
   }
 
@@ -284,13 +555,17 @@ class sink
     std::same_as<std::invoke_result_t<Func, value_type*, size_t>, size_t>
   size_t read_using(Func&& func, size_t count)
   {
-    return m_reader.read_using(
+    auto read_count = m_reader.read_using(
       std::forward<Func>(func), std::min(get_available_data_size(), count));
+    m_channel->notify_space();
+    return read_count;
   }
 
   std::vector<value_type> read(size_t count)
   {
-    return m_reader.read(std::min(get_available_data_size(), count));
+    auto values = m_reader.read(std::min(get_available_data_size(), count));
+    m_channel->notify_space();
+    return values;
   }
 
   std::vector<value_type> read_all()
@@ -299,8 +574,48 @@ class sink
     read(values.data(), values.size());
     return values;
   }
+
+  private:
+  void set_channel(const std::shared_ptr<detail::channel<buffer_pointer_type>>& channel)
+  {
+    if(m_channel != channel)
+    {
+      if(m_channel)
+      {
+        m_channel->remove_sink(this);
+      }
+
+      m_channel = channel;
+
+      if(m_channel)
+      {
+        m_channel->add_sink(this);
+      }
+    }
+  }
 };
 
+template <circular_buffer_ptr BufferPointer>
+size_t detail::channel<BufferPointer>::get_free_space() const
+{
+  std::lock_guard lock(m_sinks_mutex);
+
+  if(m_sinks.empty())
+  {
+    return std::numeric_limits<size_t>::max();
+  }
+
+  auto written = m_writer.get_index();
+  auto slowest = written;
+
+  for(auto sink : m_sinks)
+  {
+    slowest = std::min(slowest, sink->m_reader.get_index());
+  }
+
+  return CAPACITY - std::min(CAPACITY, written - slowest);
+}
+
 template <size_t SINKS_COUNT>
 constexpr auto make_spmc_channel(circular_buffer_ptr auto buffer_ptr)
   -> std::pair<source<decltype(buffer_ptr)>, std::array<sink<decltype(buffer_ptr)>, SINKS_COUNT>>
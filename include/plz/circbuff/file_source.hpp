@@ -0,0 +1,185 @@
+#ifndef __FILE_SOURCE_H__
+#define __FILE_SOURCE_H__
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include "channel.hpp"
+
+namespace plz
+{
+
+/**
+ * Streams the fixed size records of a file (the value_type of the channel)
+ * into a channel source. The file is memory mapped and the records are copied
+ * straight from the mapping into the ring with source::write_using, without
+ * intermediate buffer. The kernel is told that the mapping is read
+ * sequentially (MADV_SEQUENTIAL) and the `readahead` bytes after the read
+ * position are requested ahead of time (MADV_WILLNEED), so page faults don't
+ * stall the writer. A trailing partial record is ignored.
+ *
+ * Only available on POSIX systems.
+ *
+ * ```
+ * plz::file_source<buffer_ptr> capture("capture.bin");
+ *
+ * while(!capture.is_done())
+ * {
+ *   capture.write_to(source, 4096); // never overwrites unread values
+ * }
+ * ```
+ */
+template <circular_buffer_ptr BufferPointer>
+class file_source
+{
+  public:
+  using value_type =
+    typename array_traits<typename std::pointer_traits<BufferPointer>::element_type>::value_type;
+
+  static_assert(std::is_trivially_copyable_v<value_type>,
+    "file_source records must be trivially copyable");
+
+  explicit file_source(const std::string& path, size_t readahead = 8 * 1024 * 1024)
+    : m_readahead{ readahead }
+  {
+    m_fd = ::open(path.c_str(), O_RDONLY);
+    if(m_fd < 0)
+    {
+      throw std::system_error(errno, std::generic_category(), "cannot open " + path);
+    }
+
+    struct stat status;
+    if(::fstat(m_fd, &status) != 0)
+    {
+      auto error = errno;
+      ::close(m_fd);
+      throw std::system_error(error, std::generic_category(), "cannot stat " + path);
+    }
+
+    m_size         = static_cast<size_t>(status.st_size);
+    m_record_count = m_size / sizeof(value_type);
+
+    if(m_size > 0)
+    {
+      m_data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+      if(m_data == MAP_FAILED)
+      {
+        auto error = errno;
+        ::close(m_fd);
+        throw std::system_error(error, std::generic_category(), "cannot map " + path);
+      }
+
+      // advice only, failures are harmless
+      ::madvise(m_data, m_size, MADV_SEQUENTIAL);
+      advise_readahead();
+    }
+  }
+
+  file_source(const file_source&)            = delete;
+  file_source& operator=(const file_source&) = delete;
+
+  ~file_source()
+  {
+    if(m_data != nullptr)
+    {
+      ::munmap(m_data, m_size);
+    }
+
+    ::close(m_fd);
+  }
+
+  size_t get_record_count() const
+  {
+    return m_record_count;
+  }
+
+  size_t get_records_left() const
+  {
+    return m_record_count - m_position;
+  }
+
+  bool is_done() const
+  {
+    return m_position == m_record_count;
+  }
+
+  /**
+   * Writes up to `max_count` of the next records to `output`, no more than the
+   * free space of its channel, and returns the number of records written.
+   */
+  template <circular_buffer_ptr OutputPointer>
+    requires std::same_as<typename source<OutputPointer>::value_type, value_type>
+  size_t write_to(source<OutputPointer>& output, size_t max_count = std::numeric_limits<size_t>::max())
+  {
+    auto count = std::min({ max_count, get_records_left(), output.get_free_space() });
+    if(count == 0)
+    {
+      return 0;
+    }
+
+    auto records  = static_cast<const value_type*>(m_data) + m_position;
+    size_t offset = 0;
+
+    auto written = output.write_using(
+      [records, &offset](value_type* data, size_t size)
+      {
+        std::memcpy(data, records + offset, size * sizeof(value_type));
+        offset += size;
+        return size;
+      },
+      count);
+
+    m_position += written;
+    advise_readahead();
+
+    return written;
+  }
+
+  private:
+  // requests the pages of the readahead window that were not requested yet
+  void advise_readahead()
+  {
+    auto page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+
+    auto position = m_position * sizeof(value_type);
+    auto end      = std::min(m_size, position + m_readahead);
+    auto begin    = std::max(m_advised, position) / page_size * page_size;
+
+    if(end <= m_advised || begin >= end)
+    {
+      return;
+    }
+
+    ::madvise(static_cast<char*>(m_data) + begin, end - begin, MADV_WILLNEED);
+    m_advised = end;
+  }
+
+  int m_fd{ -1 };
+  void* m_data{ nullptr };
+  size_t m_size{ 0 };
+  size_t m_record_count{ 0 };
+  size_t m_position{ 0 };
+
+  size_t m_readahead;
+  size_t m_advised{ 0 };
+};
+
+} // namespace plz
+
+#endif // defined(__unix__) || defined(__APPLE__)
+
+#endif // __FILE_SOURCE_H__
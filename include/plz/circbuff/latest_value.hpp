@@ -0,0 +1,221 @@
+#ifndef __LATEST_VALUE_H__
+#define __LATEST_VALUE_H__
+
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include "plz/help/spin.hpp"
+
+namespace plz
+{
+
+/**
+ * Publishes the latest version of a value from one writer to any number of
+ * readers with a sequence lock: the writer never waits, readers copy the value
+ * and retry if a write happened meanwhile, so they always get a consistent
+ * copy of the latest published value. T must be trivially copyable; the value
+ * is stored as relaxed atomic words so that concurrent copies are well
+ * defined.
+ *
+ * ```
+ * plz::seqlock<book_snapshot> book;
+ *
+ * book.publish(snapshot);            // writer thread
+ * auto latest = book.load();         // any reader thread
+ * ```
+ */
+template <typename T>
+  requires std::is_trivially_copyable_v<T> && std::is_default_constructible_v<T>
+class seqlock
+{
+  public:
+  seqlock() : seqlock(T{})
+  {
+  }
+
+  explicit seqlock(const T& value)
+  {
+    store_words(value);
+  }
+
+  seqlock(const seqlock&)            = delete;
+  seqlock& operator=(const seqlock&) = delete;
+
+  /**
+   * Publishes `value`. Must only be called by one writer at a time.
+   */
+  void publish(const T& value)
+  {
+    auto sequence = m_sequence.load(std::memory_order_relaxed);
+
+    // odd while writing
+    m_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    store_words(value);
+
+    m_sequence.store(sequence + 2, std::memory_order_release);
+  }
+
+  /**
+   * Copy of the latest published value, retries while it is being written.
+   */
+  T load() const
+  {
+    T value;
+    spin_backoff backoff;
+
+    while(!try_load(value))
+    {
+      backoff.pause();
+    }
+
+    return value;
+  }
+
+  /**
+   * Copies the latest published value into `value`, returns false without
+   * waiting if it was being written.
+   */
+  bool try_load(T& value) const
+  {
+    auto before = m_sequence.load(std::memory_order_acquire);
+    if(before & 1)
+    {
+      return false;
+    }
+
+    std::array<uint64_t, WORDS> words;
+    for(size_t i = 0; i < WORDS; ++i)
+    {
+      words[i] = m_words[i].load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(m_sequence.load(std::memory_order_relaxed) != before)
+    {
+      return false;
+    }
+
+    std::memcpy(static_cast<void*>(&value), words.data(), sizeof(T));
+    return true;
+  }
+
+  /**
+   * Number of values published so far, readers can compare it to skip
+   * copying a value they already have.
+   */
+  uint64_t get_version() const
+  {
+    return m_sequence.load(std::memory_order_acquire) / 2;
+  }
+
+  private:
+  static constexpr size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  void store_words(const T& value)
+  {
+    std::array<uint64_t, WORDS> words{};
+    std::memcpy(words.data(), static_cast<const void*>(&value), sizeof(T));
+
+    for(size_t i = 0; i < WORDS; ++i)
+    {
+      m_words[i].store(words[i], std::memory_order_relaxed);
+    }
+  }
+
+  alignas(64) std::atomic<uint64_t> m_sequence{ 0 };
+  std::array<std::atomic<uint64_t>, WORDS> m_words;
+};
+
+/**
+ * Publishes the latest version of a value from one writer to one reader with
+ * three buffers: the writer fills its back buffer and swaps it with the
+ * middle one, the reader swaps its front buffer with the middle one when it
+ * holds a newer value. Neither side ever waits or copies more than the value
+ * it writes, and T can be any default constructible type.
+ *
+ * ```
+ * plz::triple_buffer<config> current;
+ *
+ * current.publish(load_config());          // writer thread
+ * const config& latest = current.read();   // reader thread
+ * ```
+ */
+template <typename T>
+  requires std::is_default_constructible_v<T>
+class triple_buffer
+{
+  public:
+  triple_buffer() = default;
+
+  triple_buffer(const triple_buffer&)            = delete;
+  triple_buffer& operator=(const triple_buffer&) = delete;
+
+  /**
+   * Publishes `value`. Must only be called by the writer thread.
+   */
+  template <typename U>
+    requires std::assignable_from<T&, U&&>
+  void publish(U&& value)
+  {
+    m_buffers[m_back].value = std::forward<U>(value);
+
+    auto previous = m_middle.exchange(m_back | DIRTY, std::memory_order_acq_rel);
+    m_back        = previous & INDEX_MASK;
+  }
+
+  /**
+   * Whether a value newer than the one returned by the last read() was
+   * published.
+   */
+  bool has_update() const
+  {
+    return (m_middle.load(std::memory_order_relaxed) & DIRTY) != 0;
+  }
+
+  /**
+   * Latest published value (a default constructed T before the first
+   * publish). The reference stays valid until the next call to read(), which
+   * must only be called by the reader thread.
+   */
+  const T& read()
+  {
+    if(has_update())
+    {
+      auto previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+      m_front       = previous & INDEX_MASK;
+    }
+
+    return m_buffers[m_front].value;
+  }
+
+  private:
+  static constexpr uint8_t INDEX_MASK = 0x3;
+  static constexpr uint8_t DIRTY      = 0x4;
+
+  struct alignas(64) buffer
+  {
+    T value{};
+  };
+
+  std::array<buffer, 3> m_buffers;
+
+  // index of the middle buffer, with DIRTY set when it holds a value the
+  // reader did not take yet
+  alignas(64) std::atomic<uint8_t> m_middle{ 1 };
+
+  // owned by the writer and by the reader
+  alignas(64) uint8_t m_back{ 0 };
+  alignas(64) uint8_t m_front{ 2 };
+};
+
+} // namespace plz
+
+#endif // __LATEST_VALUE_H__
@@ -0,0 +1,274 @@
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "channel.hpp"
+
+namespace plz
+{
+
+/**
+ * Stage of a static pipeline that transforms every value with `func`.
+ */
+template <typename Func>
+struct stage
+{
+  explicit stage(Func function) : func{ std::move(function) }
+  {
+  }
+
+  template <typename T, typename Next>
+  void apply(T&& value, Next&& next)
+  {
+    next(std::invoke(func, std::forward<T>(value)));
+  }
+
+  Func func;
+};
+
+template <typename Func>
+stage(Func) -> stage<Func>;
+
+/**
+ * Stage of a static pipeline that only passes the values `predicate` accepts.
+ */
+template <typename Predicate>
+struct filter
+{
+  explicit filter(Predicate pred) : predicate{ std::move(pred) }
+  {
+  }
+
+  template <typename T, typename Next>
+  void apply(T&& value, Next&& next)
+  {
+    if(std::invoke(predicate, std::as_const(value)))
+    {
+      next(std::forward<T>(value));
+    }
+  }
+
+  Predicate predicate;
+};
+
+template <typename Predicate>
+filter(Predicate) -> filter<Predicate>;
+
+/**
+ * End of a static pipeline: calls `func` with every value that reaches it.
+ */
+template <typename Func>
+struct into
+{
+  explicit into(Func function) : func{ std::move(function) }
+  {
+  }
+
+  template <typename T>
+  void operator()(T&& value)
+  {
+    std::invoke(func, std::forward<T>(value));
+  }
+
+  Func func;
+};
+
+template <typename Func>
+into(Func) -> into<Func>;
+
+/**
+ * End of a static pipeline that puts every value that reaches it in the
+ * channel of `output`.
+ */
+template <circular_buffer_ptr BufferPointer>
+auto into_source(source<BufferPointer>& output)
+{
+  return into(
+    [&output](const typename source<BufferPointer>::value_type& value)
+    {
+      output.put(value);
+    });
+}
+
+namespace detail
+{
+
+template <typename T>
+struct is_pipeline_stage : std::false_type
+{
+};
+
+template <typename Func>
+struct is_pipeline_stage<stage<Func>> : std::true_type
+{
+};
+
+template <typename Predicate>
+struct is_pipeline_stage<filter<Predicate>> : std::true_type
+{
+};
+
+template <typename T>
+concept pipeline_stage = is_pipeline_stage<std::remove_cvref_t<T>>::value;
+
+template <typename T>
+struct is_pipeline_end : std::false_type
+{
+};
+
+template <typename Func>
+struct is_pipeline_end<into<Func>> : std::true_type
+{
+};
+
+template <typename T>
+concept pipeline_end = is_pipeline_end<std::remove_cvref_t<T>>::value;
+
+} // namespace detail
+
+/**
+ * Static pipeline fed by a sink: the stages and the end are template
+ * parameters and call each other directly, so the compiler can inline the
+ * whole chain in the loop that drains the sink. Built with operator|:
+ *
+ * ```
+ * auto flow = sink | plz::stage(parse) | plz::filter(is_valid) | plz::into(store);
+ * plz::connect(&source, &flow); // one call per write, for the whole chain
+ * ```
+ *
+ * Without an end (End = void) the pipeline can only be extended.
+ */
+template <circular_buffer_ptr BufferPointer, typename End, typename... Stages>
+class pipeline
+{
+  public:
+  using value_type = typename sink<BufferPointer>::value_type;
+
+  pipeline(sink<BufferPointer>* input, std::tuple<Stages...> stages, End end = {})
+    requires(!std::is_void_v<End>)
+    : m_input{ input }, m_stages{ std::move(stages) }, m_end{ std::move(end) }
+  {
+  }
+
+  /**
+   * Runs up to `max_count` available values of the sink through the pipeline,
+   * in a single loop over the contiguous spans of the ring. Returns the number
+   * of values read.
+   */
+  size_t drain(size_t max_count = std::numeric_limits<size_t>::max())
+  {
+    return m_input->read_using(
+      [this](value_type* values, size_t count)
+      {
+        for(size_t i = 0; i < count; ++i)
+        {
+          push<0>(values[i]);
+        }
+
+        return count;
+      },
+      max_count);
+  }
+
+  /**
+   * Runs a single value through the pipeline, without going through the sink.
+   */
+  template <typename T>
+  void push(T&& value)
+  {
+    push<0>(std::forward<T>(value));
+  }
+
+  private:
+  template <circular_buffer_ptr, typename, typename...>
+  friend class pipeline;
+
+  template <size_t INDEX, typename T>
+  void push(T&& value)
+  {
+    if constexpr(INDEX == sizeof...(Stages))
+    {
+      m_end(std::forward<T>(value));
+    }
+    else
+    {
+      std::get<INDEX>(m_stages).apply(std::forward<T>(value),
+        [this](auto&& result)
+        {
+          push<INDEX + 1>(std::forward<decltype(result)>(result));
+        });
+    }
+  }
+
+  sink<BufferPointer>* m_input;
+  std::tuple<Stages...> m_stages;
+  End m_end;
+};
+
+// pipeline without its end yet
+template <circular_buffer_ptr BufferPointer, typename... Stages>
+class pipeline<BufferPointer, void, Stages...>
+{
+  public:
+  pipeline(sink<BufferPointer>* input, std::tuple<Stages...> stages)
+    : m_input{ input }, m_stages{ std::move(stages) }
+  {
+  }
+
+  sink<BufferPointer>* m_input;
+  std::tuple<Stages...> m_stages;
+};
+
+template <circular_buffer_ptr BufferPointer, detail::pipeline_stage Stage>
+auto operator|(sink<BufferPointer>& input, Stage&& next)
+{
+  return pipeline<BufferPointer, void, std::remove_cvref_t<Stage>>(
+    &input, std::make_tuple(std::forward<Stage>(next)));
+}
+
+template <circular_buffer_ptr BufferPointer, detail::pipeline_end End>
+auto operator|(sink<BufferPointer>& input, End&& end)
+{
+  return pipeline<BufferPointer, std::remove_cvref_t<End>>(
+    &input, std::tuple<>{}, std::forward<End>(end));
+}
+
+template <circular_buffer_ptr BufferPointer, typename... Stages, detail::pipeline_stage Stage>
+auto operator|(pipeline<BufferPointer, void, Stages...>&& head, Stage&& next)
+{
+  return pipeline<BufferPointer, void, Stages..., std::remove_cvref_t<Stage>>(head.m_input,
+    std::tuple_cat(std::move(head.m_stages), std::make_tuple(std::forward<Stage>(next))));
+}
+
+template <circular_buffer_ptr BufferPointer, typename... Stages, detail::pipeline_end End>
+auto operator|(pipeline<BufferPointer, void, Stages...>&& head, End&& end)
+{
+  return pipeline<BufferPointer, std::remove_cvref_t<End>, Stages...>(
+    head.m_input, std::move(head.m_stages), std::forward<End>(end));
+}
+
+/**
+ * Drains `flow` every time `source` writes, with a single notify function for
+ * the whole pipeline.
+ */
+template <circular_buffer_ptr BufferPointer, typename End, typename... Stages>
+  requires(!std::is_void_v<End>)
+source_connection connect(source<BufferPointer>* source, pipeline<BufferPointer, End, Stages...>* flow)
+{
+  return source_connection{ source->register_notify_function(
+    [flow](size_t count)
+    {
+      flow->drain(count);
+    }) };
+}
+
+} // namespace plz
+
+#endif // __PIPELINE_H__
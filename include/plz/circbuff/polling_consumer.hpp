@@ -0,0 +1,189 @@
+#ifndef __POLLING_CONSUMER_H__
+#define __POLLING_CONSUMER_H__
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <latch>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "plz/help/spin.hpp"
+
+#include "channel.hpp"
+
+namespace plz
+{
+
+struct polling_options
+{
+  // cpu the polling thread is pinned to (Linux only), none by default
+  std::optional<size_t> cpu;
+
+  // number of empty polls before the thread starts sleeping between polls,
+  // 0 to spin forever
+  size_t idle_spins{ 0 };
+
+  // sleeps start at 1us and double up to this duration while idle
+  std::chrono::microseconds max_idle_sleep{ 1000 };
+
+  // most values handed to the handler per read
+  size_t batch_size{ std::numeric_limits<size_t>::max() };
+};
+
+/**
+ * Dedicated thread that busy polls a sink for the lowest latency: it spins on
+ * the writer index with cpu_relax and calls handler(values, count) on the new
+ * spans of the ring as soon as they are written, without system call, notify
+ * function or thread_pool task in between. The handler returns the number of
+ * values it consumed, like for sink::read_using.
+ *
+ * The thread can be pinned to a cpu that should be kept free of other work,
+ * and can fall back to sleeping (up to max_idle_sleep) after `idle_spins`
+ * empty polls. The sink must outlive the consumer, which stops and joins its
+ * thread when destroyed.
+ *
+ * ```
+ * plz::polling_consumer consumer(orders, [&](order* values, size_t count)
+ *   {
+ *     for(size_t i = 0; i < count; ++i) book.apply(values[i]);
+ *     return count;
+ *   },
+ *   plz::polling_options{ .cpu = 3 });
+ * ```
+ */
+template <circular_buffer_ptr BufferPointer, typename Handler>
+  requires std::invocable<Handler&, typename sink<BufferPointer>::value_type*, size_t> &&
+  std::same_as<std::invoke_result_t<Handler&, typename sink<BufferPointer>::value_type*, size_t>, size_t>
+class polling_consumer
+{
+  public:
+  /**
+   * Throws std::invalid_argument if polling_options::cpu is not below
+   * CPU_SETSIZE. Returns once the thread is pinned (or failed to be), before
+   * it polls.
+   */
+  polling_consumer(sink<BufferPointer>& input, Handler handler, polling_options options = {})
+    : m_sink{ &input }, m_handler{ std::move(handler) }, m_options{ std::move(options) }
+  {
+#if defined(__linux__)
+    if(m_options.cpu && *m_options.cpu >= CPU_SETSIZE)
+    {
+      throw std::invalid_argument("polling_consumer cpu out of range");
+    }
+#endif
+
+    m_thread = std::jthread(
+      [this](std::stop_token token)
+      {
+        pin();
+        m_started.count_down();
+        poll(token);
+      });
+
+    m_started.wait();
+  }
+
+  polling_consumer(const polling_consumer&)            = delete;
+  polling_consumer& operator=(const polling_consumer&) = delete;
+
+  /**
+   * Stops polling and waits for the thread. Values written afterwards are left
+   * in the sink.
+   */
+  void stop()
+  {
+    if(m_thread.joinable())
+    {
+      m_thread.request_stop();
+      m_thread.join();
+    }
+  }
+
+  /**
+   * Whether the thread is pinned to polling_options::cpu.
+   */
+  bool is_pinned() const
+  {
+    return m_pinned;
+  }
+
+  size_t get_read_count() const
+  {
+    return m_read_count.load(std::memory_order_acquire);
+  }
+
+  private:
+  void poll(std::stop_token token)
+  {
+    size_t idle_polls = 0;
+    std::chrono::microseconds sleep{ 1 };
+
+    while(!token.stop_requested())
+    {
+      if(m_sink->get_available_data_size() > 0)
+      {
+        auto read = m_sink->read_using(m_handler, m_options.batch_size);
+        m_read_count.fetch_add(read, std::memory_order_release);
+
+        idle_polls = 0;
+        sleep      = std::chrono::microseconds{ 1 };
+        continue;
+      }
+
+      if(m_options.idle_spins == 0 || ++idle_polls < m_options.idle_spins)
+      {
+        cpu_relax();
+        continue;
+      }
+
+      std::this_thread::sleep_for(sleep);
+      sleep = std::min(sleep * 2, m_options.max_idle_sleep);
+    }
+  }
+
+  void pin()
+  {
+    if(!m_options.cpu)
+    {
+      return;
+    }
+
+#if defined(__linux__)
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(*m_options.cpu, &cpus);
+
+    m_pinned = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#endif
+  }
+
+  sink<BufferPointer>* m_sink;
+  Handler m_handler;
+  polling_options m_options;
+
+  bool m_pinned{ false };
+  std::atomic<size_t> m_read_count{ 0 };
+
+  // counted down by the thread once pinned
+  std::latch m_started{ 1 };
+
+  // last, so that it is stopped before the members it uses are destroyed
+  std::jthread m_thread;
+};
+
+} // namespace plz
+
+#endif // __POLLING_CONSUMER_H__
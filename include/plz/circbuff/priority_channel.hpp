@@ -0,0 +1,311 @@
+#ifndef __PRIORITY_CHANNEL_H__
+#define __PRIORITY_CHANNEL_H__
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "plz/help/array_traits.hpp"
+
+#include "concepts.hpp"
+#include "reader.hpp"
+#include "writer.hpp"
+
+namespace plz
+{
+
+enum class drop_policy
+{
+  // a write to a full level replaces its oldest unread value
+  overwrite_oldest,
+  // a write to a full level is dropped
+  drop_newest
+};
+
+struct priority_level_options
+{
+  // most unread values the level holds, at most the capacity of the buffer
+  size_t capacity;
+  drop_policy policy{ drop_policy::overwrite_oldest };
+};
+
+/**
+ * Multi producer, single consumer channel with LEVELS rings, level 0 being the
+ * highest priority: the consumer always drains the higher levels first, so
+ * control messages don't wait behind bulk data. Every level has its own
+ * capacity and drop policy and producers of different levels don't share a
+ * lock. A consumer blocked in wait_for_data/get is woken by a write to any
+ * level.
+ *
+ * ```
+ * plz::priority_channel<buffer_ptr, 2> channel([] { return std::make_shared<std::array<message, 4096>>(); },
+ *   { plz::priority_level_options{ 64, plz::drop_policy::drop_newest },
+ *     plz::priority_level_options{ 4096 } });
+ *
+ * channel.put(0, stop_message);     // control
+ * channel.put(1, data_message);     // bulk
+ *
+ * while(auto message = channel.get(100ms)) handle(*message);
+ * ```
+ */
+template <circbuff::circular_buffer_ptr BufferPointer, size_t LEVELS>
+  requires(LEVELS > 0)
+class priority_channel
+{
+  public:
+  using buffer_ptr_type = BufferPointer;
+  using array_type = typename std::pointer_traits<buffer_ptr_type>::element_type;
+  using value_type =
+    typename array_traits<typename std::pointer_traits<buffer_ptr_type>::element_type>::value_type;
+
+  static constexpr size_t CAPACITY = array_traits<array_type>::capacity;
+
+  using buffer_factory = std::function<buffer_ptr_type()>;
+
+  /**
+   * Every level overwrites its oldest values and holds CAPACITY values.
+   */
+  explicit priority_channel(const buffer_factory& make_buffer)
+    : priority_channel(make_buffer, default_options())
+  {
+  }
+
+  priority_channel(const buffer_factory& make_buffer, const std::array<priority_level_options, LEVELS>& options)
+  {
+    for(size_t i = 0; i < LEVELS; ++i)
+    {
+      if(options[i].capacity == 0 || options[i].capacity > CAPACITY)
+      {
+        throw std::invalid_argument("priority level capacity must be in [1, CAPACITY]");
+      }
+
+      m_levels[i] = std::make_unique<level>(make_buffer(), options[i]);
+    }
+  }
+
+  priority_channel(const priority_channel&)            = delete;
+  priority_channel& operator=(const priority_channel&) = delete;
+
+  /**
+   * Writes `value` to `priority` (0 is the highest). Returns false if the
+   * level is full and drops new values.
+   */
+  bool put(size_t priority, const value_type& value)
+  {
+    auto& current = get_level(priority);
+
+    {
+      std::lock_guard lock(current.mutex);
+
+      if(current.get_size() >= current.options.capacity)
+      {
+        current.dropped++;
+
+        if(current.options.policy == drop_policy::drop_newest)
+        {
+          return false;
+        }
+      }
+
+      current.writer.put(value);
+    }
+
+    notify();
+    return true;
+  }
+
+  /**
+   * Reads up to `count` values, from the highest levels first.
+   */
+  size_t read(value_type* values, size_t count)
+  {
+    size_t read = 0;
+
+    for(auto& current : m_levels)
+    {
+      if(read == count)
+      {
+        break;
+      }
+
+      std::lock_guard lock(current->mutex);
+      current->skip_overwritten();
+
+      auto size = std::min(current->get_size(), count - read);
+      current->reader.read(values + read, size);
+      read += size;
+    }
+
+    return read;
+  }
+
+  std::vector<value_type> read(size_t count)
+  {
+    std::vector<value_type> values(std::min(count, get_available_data_size()));
+    values.resize(read(values.data(), values.size()));
+    return values;
+  }
+
+  std::optional<value_type> try_get()
+  {
+    value_type value;
+    if(read(&value, 1) == 0)
+    {
+      return std::nullopt;
+    }
+
+    return value;
+  }
+
+  /**
+   * Waits up to `timeout` for a value of any level and returns the value of
+   * the highest level.
+   */
+  template <typename Rep, typename Period>
+  std::optional<value_type> get(std::chrono::duration<Rep, Period> timeout)
+  {
+    if(!wait_for_data(timeout))
+    {
+      return std::nullopt;
+    }
+
+    return try_get();
+  }
+
+  /**
+   * Waits up to `timeout` until a level has data. Returns false on timeout.
+   */
+  template <typename Rep, typename Period>
+  bool wait_for_data(std::chrono::duration<Rep, Period> timeout)
+  {
+    if(get_available_data_size() > 0)
+    {
+      return true;
+    }
+
+    std::unique_lock lock(m_wakeup_mutex);
+    m_waiting = true;
+
+    // the flag is set before checking the levels and the producers write
+    // before checking the flag, so either we see the data or they notify
+    auto ready = m_condition.wait_for(lock,
+      timeout,
+      [this]
+      {
+        return get_available_data_size() > 0;
+      });
+
+    m_waiting = false;
+    return ready;
+  }
+
+  size_t get_available_data_size() const
+  {
+    size_t size = 0;
+    for(auto& current : m_levels)
+    {
+      size += std::min(current->get_size(), current->options.capacity);
+    }
+
+    return size;
+  }
+
+  size_t get_available_data_size(size_t priority) const
+  {
+    auto& current = get_level(priority);
+    return std::min(current.get_size(), current.options.capacity);
+  }
+
+  /**
+   * Number of values of `priority` that were dropped or overwritten because
+   * the level was full.
+   */
+  size_t get_dropped_count(size_t priority) const
+  {
+    auto& current = get_level(priority);
+    std::lock_guard lock(current.mutex);
+    return current.dropped;
+  }
+
+  private:
+  struct alignas(64) level
+  {
+    level(buffer_ptr_type buffer, const priority_level_options& level_options)
+      : writer{ buffer }, reader{ buffer }, options{ level_options }
+    {
+    }
+
+    // unread values, including the overwritten ones not skipped yet
+    size_t get_size() const
+    {
+      return writer.get_index() - reader.get_index();
+    }
+
+    void skip_overwritten()
+    {
+      auto size = get_size();
+      if(size > options.capacity)
+      {
+        reader.read_using(
+          [](value_type*, size_t count)
+          {
+            return count;
+          },
+          size - options.capacity);
+      }
+    }
+
+    mutable std::mutex mutex;
+    plz::circbuff::writer<buffer_ptr_type> writer;
+    plz::circbuff::reader<buffer_ptr_type> reader;
+    priority_level_options options;
+    size_t dropped{ 0 };
+  };
+
+  static std::array<priority_level_options, LEVELS> default_options()
+  {
+    std::array<priority_level_options, LEVELS> options;
+    options.fill({ CAPACITY, drop_policy::overwrite_oldest });
+    return options;
+  }
+
+  level& get_level(size_t priority) const
+  {
+    if(priority >= LEVELS)
+    {
+      throw std::out_of_range("priority level out of range");
+    }
+
+    return *m_levels[priority];
+  }
+
+  void notify()
+  {
+    if(m_waiting)
+    {
+      std::lock_guard lock(m_wakeup_mutex);
+      m_condition.notify_one();
+    }
+  }
+
+  std::array<std::unique_ptr<level>, LEVELS> m_levels;
+
+  // single wake up shared by all the levels
+  std::mutex m_wakeup_mutex;
+  std::condition_variable m_condition;
+  std::atomic<bool> m_waiting{ false };
+};
+
+} // namespace plz
+
+#endif // __PRIORITY_CHANNEL_H__
@@ -11,6 +11,7 @@
 #include "plz/help/type_traits.hpp"
 
 #include "concepts.hpp"
+#include "transfer.hpp"
 
 namespace plz::circbuff
 {
@@ -18,6 +19,14 @@ namespace plz::circbuff
 template <size_t MIN_CONTIGUOUS_SIZE = 0>
 constexpr auto make_reader(circular_buffer_ptr auto buffer);
 
+/**
+ * Reads the values of a circular buffer written by a plz::circbuff::writer.
+ * Readers of the same buffer are independent: each one keeps its own index,
+ * which is what lets a channel broadcast every value to all of its sinks
+ * (SPMC). The reads therefore copy the values out of the slots and never move
+ * them, another reader may still have to read the same slot, and the element
+ * type must be copyable (see transferable_element).
+ */
 template <circular_buffer_ptr BufferPointer, size_t MIN_CONTIGUOUS_SIZE = 0>
 class reader
 {
@@ -30,6 +39,9 @@ class reader
   using value_type =
     typename array_traits<typename std::pointer_traits<BufferPointer>::element_type>::value_type;
 
+  static_assert(transferable_element<value_type>,
+    "circbuff elements are copied to every reader of the buffer, move-only types are not supported");
+
   constexpr static size_t get_buffer_capacity()
   {
     return array_traits<array_type>::capacity;
@@ -130,7 +142,7 @@ class reader
     peek_using(
       [&offset, values](value_type* data, size_t size)
       {
-        std::memcpy(values + offset, data, size * sizeof(value_type));
+        copy_elements(values + offset, data, size);
         offset += size;
         return size;
       },
@@ -168,13 +180,15 @@ class reader
     return values;
   }
 
+  // copies rather than moves: the other readers of the buffer may still read
+  // the same elements
   void read(value_type* values, size_t count)
   {
     size_t offset = 0;
     read_using(
       [&offset, values](value_type* data, size_t size)
       {
-        std::memcpy(values + offset, data, size * sizeof(value_type));
+        copy_elements(values + offset, data, size);
         offset += size;
         return size;
       },
@@ -252,9 +266,7 @@ class reader
   {
     assert(count < g_min_contiguous_size);
 
-    std::memcpy(m_min_contiguous_buffer->data(),
-      m_buffer->data() + index,
-      count * sizeof(value_type));
+    copy_elements(m_min_contiguous_buffer->data(), m_buffer->data() + index, count);
 
     auto read_size =
       std::min(func(m_min_contiguous_buffer->data(), g_min_contiguous_size), count);
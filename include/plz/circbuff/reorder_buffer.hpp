@@ -0,0 +1,264 @@
+#ifndef __REORDER_BUFFER_H__
+#define __REORDER_BUFFER_H__
+
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "channel.hpp"
+
+namespace plz
+{
+
+/**
+ * Restores the order of results computed in parallel: workers push
+ * (sequence, result) pairs in any order and the results are put in `output`
+ * strictly by sequence, as soon as the next expected one arrived and the
+ * output has free space (see source::get_free_space).
+ *
+ * At most `window` results wait for their predecessors or for the output:
+ * push blocks a worker whose sequence is `window` or more ahead of the next
+ * expected one, which bounds the memory and applies the backpressure of the
+ * output to the fast workers. The window must be larger than the number of
+ * results in flight that can be ahead of the next expected one, or the
+ * workers holding them wait forever; try_push never blocks.
+ *
+ * The results held while the output is full are put by the thread that reads
+ * the output, once it made room. The output source must outlive the buffer.
+ *
+ * The results still pending when the buffer is destroyed, waiting for a
+ * missing predecessor or for room in the output, are dropped. Debug builds
+ * assert that there are none: call discard_pending() to drop them on purpose,
+ * e.g. when the pipeline was cancelled.
+ *
+ * ```
+ * plz::reorder_buffer ordered(output, 64);
+ *
+ * pool.map(std::views::iota(0, count), [&](int i) { ordered.push(i, process(inputs[i])); });
+ * ```
+ */
+template <circular_buffer_ptr OutputPointer>
+class reorder_buffer
+{
+  public:
+  using value_type = typename source<OutputPointer>::value_type;
+
+  reorder_buffer(source<OutputPointer>& output, size_t window, uint64_t first_sequence = 0)
+    : m_state{ std::make_shared<state>(output, window, first_sequence) }
+  {
+    if(window == 0)
+    {
+      throw std::invalid_argument("reorder_buffer window must be positive");
+    }
+  }
+
+  reorder_buffer(const reorder_buffer&)            = delete;
+  reorder_buffer& operator=(const reorder_buffer&) = delete;
+
+  // a space waiter of the output may still be registered, it must no longer
+  // put, and a put in progress must be done before the output may go away
+  ~reorder_buffer()
+  {
+    std::unique_lock lock(m_state->mutex);
+    m_state->closed = true;
+    m_state->condition.wait(lock,
+      [this]
+      {
+        return !m_state->flushing;
+      });
+
+    assert(m_state->pending == 0 && "reorder_buffer destroyed with pending results, see discard_pending");
+  }
+
+  /**
+   * Stores the result of `sequence`, waiting while it is outside of the
+   * window, and puts the results that are now in order in the output.
+   */
+  void push(uint64_t sequence, value_type value)
+  {
+    std::unique_lock lock(m_state->mutex);
+
+    m_state->condition.wait(lock,
+      [this, sequence]
+      {
+        return sequence < m_state->next + m_state->slots.size();
+      });
+
+    m_state->store(sequence, std::move(value));
+    m_state->flush(lock);
+  }
+
+  /**
+   * Same as push, but returns false instead of waiting when `sequence` is
+   * outside of the window.
+   */
+  bool try_push(uint64_t sequence, value_type value)
+  {
+    std::unique_lock lock(m_state->mutex);
+
+    if(sequence >= m_state->next + m_state->slots.size())
+    {
+      return false;
+    }
+
+    m_state->store(sequence, std::move(value));
+    m_state->flush(lock);
+    return true;
+  }
+
+  /**
+   * Sequence of the next result to put in the output.
+   */
+  uint64_t get_next_sequence() const
+  {
+    std::lock_guard lock(m_state->mutex);
+    return m_state->next;
+  }
+
+  /**
+   * Number of results waiting for their predecessors or for the output.
+   */
+  size_t get_pending_count() const
+  {
+    std::lock_guard lock(m_state->mutex);
+    return m_state->pending;
+  }
+
+  /**
+   * Drops the results waiting for their predecessors or for the output and
+   * returns how many there were. The buffer still expects the same next
+   * sequence, the dropped ones may be pushed again.
+   */
+  size_t discard_pending()
+  {
+    std::lock_guard lock(m_state->mutex);
+
+    auto discarded = m_state->pending;
+    for(auto& slot : m_state->slots)
+    {
+      slot.reset();
+    }
+
+    m_state->pending = 0;
+    m_state->condition.notify_all();
+    return discarded;
+  }
+
+  private:
+  // Shared with the space waiter registered on the output, which may be
+  // called after the buffer was destroyed
+  struct state : std::enable_shared_from_this<state>
+  {
+    state(source<OutputPointer>& output, size_t window, uint64_t first_sequence)
+      : output{ &output }, slots(window), next{ first_sequence }
+    {
+    }
+
+    void store(uint64_t sequence, value_type&& value)
+    {
+      if(sequence < next || slots[sequence % slots.size()])
+      {
+        throw std::invalid_argument("reorder_buffer sequence pushed twice");
+      }
+
+      slots[sequence % slots.size()].emplace(std::move(value));
+      pending++;
+    }
+
+    // One thread puts at a time, so that the results stay in order, and
+    // without the mutex. The others only ask it to look again.
+    void flush(std::unique_lock<std::mutex>& lock)
+    {
+      flush_requested = true;
+      if(flushing)
+      {
+        return;
+      }
+
+      flushing = true;
+      while(flush_requested && !closed)
+      {
+        flush_requested = false;
+        put_ready(lock);
+      }
+
+      flushing = false;
+      condition.notify_all();
+    }
+
+    void put_ready(std::unique_lock<std::mutex>& lock)
+    {
+      while(!closed && slots[next % slots.size()])
+      {
+        if(output->get_free_space() == 0)
+        {
+          wait_for_space(lock);
+          return;
+        }
+
+        auto& slot = slots[next % slots.size()];
+        auto value = std::move(*slot);
+        slot.reset();
+        pending--;
+        next++;
+        condition.notify_all();
+
+        lock.unlock();
+        output->put(std::move(value));
+        lock.lock();
+      }
+    }
+
+    // the waiter is called by the thread that reads the output, possibly
+    // right away, it then asks the flushing thread to look again
+    void wait_for_space(std::unique_lock<std::mutex>& lock)
+    {
+      if(waiting_for_space)
+      {
+        return;
+      }
+
+      waiting_for_space = true;
+      lock.unlock();
+      output->wait_for_space(plz::callable<void()>(
+        [weak_self = this->weak_from_this()]
+        {
+          if(auto self = weak_self.lock())
+          {
+            std::unique_lock lock(self->mutex);
+            self->waiting_for_space = false;
+            self->flush(lock);
+          }
+        }));
+      lock.lock();
+    }
+
+    source<OutputPointer>* output;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    // slot of a sequence is sequence % window
+    std::vector<std::optional<value_type>> slots;
+    uint64_t next;
+    size_t pending{ 0 };
+
+    bool flushing{ false };
+    bool flush_requested{ false };
+    bool waiting_for_space{ false };
+    bool closed{ false };
+  };
+
+  std::shared_ptr<state> m_state;
+};
+
+} // namespace plz
+
+#endif // __REORDER_BUFFER_H__
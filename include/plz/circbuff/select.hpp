@@ -0,0 +1,231 @@
+#ifndef __SELECT_H__
+#define __SELECT_H__
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "plz/help/callable.hpp"
+
+#include "channel.hpp"
+
+namespace plz
+{
+
+namespace detail
+{
+
+// Wait object shared by the sinks of a select: the writers of any of their
+// channels signal it. It lives on the stack of select, which waits for every
+// registered waiter to be cancelled or called before it returns: a writer
+// may have taken a waiter out of its list and not have called it yet.
+struct select_signal
+{
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool signaled{ false };
+  size_t pending{ 0 };
+
+  // Notifies under the lock, select may destroy the signal once it is released
+  void notify()
+  {
+    std::lock_guard lock(mutex);
+    signaled = true;
+    --pending;
+    condition.notify_all();
+  }
+};
+
+// Type erased view of a sink<BufferPointer> for select
+struct select_entry
+{
+  void* sink;
+  bool (*is_ready)(void* sink);
+  size_t (*wait)(void* sink, plz::callable<void()> waiter);
+  bool (*cancel)(void* sink, size_t id);
+
+  template <circular_buffer_ptr BufferPointer>
+  static select_entry of(plz::sink<BufferPointer>& input)
+  {
+    return { &input,
+      [](void* sink)
+      {
+        auto& self = *static_cast<plz::sink<BufferPointer>*>(sink);
+        return self.get_available_data_size() > 0 || self.is_closed();
+      },
+      [](void* sink, plz::callable<void()> waiter)
+      {
+        return static_cast<plz::sink<BufferPointer>*>(sink)->wait_for_data(std::move(waiter));
+      },
+      [](void* sink, size_t id)
+      {
+        return static_cast<plz::sink<BufferPointer>*>(sink)->cancel_wait_for_data(id);
+      } };
+  }
+};
+
+inline std::optional<size_t> first_ready(std::span<const select_entry> entries)
+{
+  for(size_t i = 0; i < entries.size(); ++i)
+  {
+    if(entries[i].is_ready(entries[i].sink))
+    {
+      return i;
+    }
+  }
+
+  return std::nullopt;
+}
+
+// `ids` has one slot per entry, the callers provide it so that the variadic
+// select does not allocate
+inline std::optional<size_t> select_until(std::span<const select_entry> entries,
+  std::span<size_t> ids,
+  std::optional<std::chrono::steady_clock::time_point> deadline)
+{
+  if(auto ready = first_ready(entries))
+  {
+    return ready;
+  }
+
+  while(true)
+  {
+    select_signal signal;
+    signal.pending = entries.size();
+
+    for(size_t i = 0; i < entries.size(); ++i)
+    {
+      ids[i] = entries[i].wait(entries[i].sink,
+        plz::callable<void()>::from<select_signal, &select_signal::notify>(&signal));
+    }
+
+    bool timed_out = false;
+    {
+      std::unique_lock lock(signal.mutex);
+      auto signaled = [&signal]
+      {
+        return signal.signaled;
+      };
+
+      if(deadline)
+      {
+        timed_out = !signal.condition.wait_until(lock, *deadline, signaled);
+      }
+      else
+      {
+        signal.condition.wait(lock, signaled);
+      }
+    }
+
+    // the waiters of the sinks that were not written stay registered otherwise
+    size_t cancelled = 0;
+    for(size_t i = 0; i < entries.size(); ++i)
+    {
+      cancelled += entries[i].cancel(entries[i].sink, ids[i]) ? 1 : 0;
+    }
+
+    {
+      std::unique_lock lock(signal.mutex);
+      signal.pending -= cancelled;
+      signal.condition.wait(lock,
+        [&signal]
+        {
+          return signal.pending == 0;
+        });
+    }
+
+    // another consumer may have drained the sink that signaled
+    if(auto ready = first_ready(entries))
+    {
+      return ready;
+    }
+
+    if(timed_out)
+    {
+      return std::nullopt;
+    }
+  }
+}
+
+} // namespace detail
+
+/**
+ * Blocks until one of `sinks` has data to read or is closed and returns its
+ * index in the arguments (the first ready one), or std::nullopt if none is
+ * after `timeout`. The calling thread sleeps on a single wait object that the
+ * writers of all the channels signal, instead of polling the sinks. That
+ * wait object lives on the stack, but registering it on a channel adds an
+ * entry to the channel's list of waiters, which may allocate:
+ *
+ * ```
+ * while(auto ready = plz::select(100ms, quotes, trades, news))
+ * {
+ *   switch(*ready) { ... }
+ * }
+ * ```
+ *
+ * The timeout comes first since it can't follow a parameter pack, the span
+ * overload takes it first too.
+ */
+template <typename Rep, typename Period, circular_buffer_ptr... BufferPointers>
+  requires(sizeof...(BufferPointers) > 0)
+std::optional<size_t>
+select(std::chrono::duration<Rep, Period> timeout, sink<BufferPointers>&... sinks)
+{
+  std::array<detail::select_entry, sizeof...(BufferPointers)> entries{ detail::select_entry::of(
+    sinks)... };
+  std::array<size_t, sizeof...(BufferPointers)> ids;
+
+  return detail::select_until(entries,
+    ids,
+    std::chrono::steady_clock::now() +
+      std::chrono::ceil<std::chrono::steady_clock::duration>(timeout));
+}
+
+/**
+ * Blocks without timeout until one of `sinks` has data to read or is closed
+ * and returns its index in the arguments.
+ */
+template <circular_buffer_ptr... BufferPointers>
+  requires(sizeof...(BufferPointers) > 0)
+size_t select(sink<BufferPointers>&... sinks)
+{
+  std::array<detail::select_entry, sizeof...(BufferPointers)> entries{ detail::select_entry::of(
+    sinks)... };
+  std::array<size_t, sizeof...(BufferPointers)> ids;
+
+  return *detail::select_until(entries, ids, std::nullopt);
+}
+
+/**
+ * select over a runtime number of sinks of the same type, e.g. dozens of
+ * feeds serviced by one consumer thread. It allocates its bookkeeping for
+ * the sinks on every call.
+ */
+template <typename Rep, typename Period, circular_buffer_ptr BufferPointer>
+std::optional<size_t>
+select(std::chrono::duration<Rep, Period> timeout, std::span<sink<BufferPointer>> sinks)
+{
+  std::vector<detail::select_entry> entries;
+  entries.reserve(sinks.size());
+  for(auto& input : sinks)
+  {
+    entries.push_back(detail::select_entry::of(input));
+  }
+
+  std::vector<size_t> ids(sinks.size());
+
+  return detail::select_until(entries,
+    ids,
+    std::chrono::steady_clock::now() +
+      std::chrono::ceil<std::chrono::steady_clock::duration>(timeout));
+}
+
+} // namespace plz
+
+#endif // __SELECT_H__
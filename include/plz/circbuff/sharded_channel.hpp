@@ -0,0 +1,321 @@
+#ifndef __SHARDED_CHANNEL_H__
+#define __SHARDED_CHANNEL_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "channel.hpp"
+
+namespace plz
+{
+
+namespace detail
+{
+
+inline std::atomic<uint64_t> g_sharded_channel_id_counter{ 0 };
+
+} // namespace detail
+
+/**
+ * Multi producer, single consumer channel made of one SPSC ring per producer
+ * thread. A producer writes to its own ring (created by `make_buffer` the first
+ * time the thread writes), so producers never share an index or a cache line,
+ * unlike make_mpsc_channel where all the sources write through one writer.
+ *
+ * The consumer drains the rings fairly in batches with read/read_using, or
+ * merged by a user key (e.g. a timestamp) with read_merged.
+ *
+ * ```
+ * plz::sharded_channel events([] { return std::make_shared<std::array<event, 4096>>(); });
+ *
+ * // any number of producer threads
+ * events.put(event{ now(), ... });
+ *
+ * // the consumer thread
+ * auto batch = events.read_merged([](const event& e) { return e.timestamp; });
+ * ```
+ */
+template <circular_buffer_ptr BufferPointer>
+class sharded_channel
+{
+  public:
+  using buffer_ptr_type = BufferPointer;
+  using array_type = typename std::pointer_traits<buffer_ptr_type>::element_type;
+  using value_type =
+    typename array_traits<typename std::pointer_traits<buffer_ptr_type>::element_type>::value_type;
+
+  // capacity of the ring of each producer
+  static constexpr size_t CAPACITY = array_traits<array_type>::capacity;
+
+  using buffer_factory = std::function<buffer_ptr_type()>;
+
+  /**
+   * `max_shards` bounds the number of threads that write concurrently,
+   * local_source throws std::runtime_error beyond it. The shard of a thread
+   * that exited is handed to the next new producer thread once the consumer
+   * drained it.
+   */
+  explicit sharded_channel(buffer_factory make_buffer, size_t max_shards = 64)
+    : m_make_buffer{ std::move(make_buffer) }, m_shards(max_shards)
+  {
+  }
+
+  sharded_channel(const sharded_channel&)            = delete;
+  sharded_channel& operator=(const sharded_channel&) = delete;
+
+  /**
+   * Source of the calling thread, created on its first call. Only the calling
+   * thread may write to it.
+   */
+  source<buffer_ptr_type>& local_source()
+  {
+    for(auto& [id, local] : s_local_shards.entries)
+    {
+      if(id == m_id)
+      {
+        // the channel owns the shard and outlives the calls on it
+        return local.lock()->source;
+      }
+    }
+
+    // the entries of the destroyed channels are dropped here, so that a thread
+    // writing to short lived channels does not accumulate them
+    std::erase_if(s_local_shards.entries,
+      [](const auto& entry)
+      {
+        return entry.second.expired();
+      });
+
+    auto local = acquire_shard();
+    s_local_shards.entries.push_back({ m_id, local });
+    return local->source;
+  }
+
+  void put(const value_type& value)
+  {
+    local_source().put(value);
+  }
+
+  void write(const value_type* values, size_t count)
+  {
+    local_source().write(values, count);
+  }
+
+  size_t get_shard_count() const
+  {
+    return m_shard_count.load(std::memory_order_acquire);
+  }
+
+  size_t get_available_data_size() const
+  {
+    size_t size = 0;
+    for(size_t i = 0, count = get_shard_count(); i < count; ++i)
+    {
+      size += m_shards[i]->sink.get_available_data_size();
+    }
+
+    return size;
+  }
+
+  /**
+   * Calls func(values, count) on up to `batch_size` values of every ring, in a
+   * single pass that starts one ring further at each call so that no producer
+   * gets ahead of the others. Returns the number of values read.
+   */
+  template <typename Func>
+    requires std::invocable<Func&, value_type*, size_t> &&
+    std::same_as<std::invoke_result_t<Func&, value_type*, size_t>, size_t>
+  size_t read_using(Func&& func, size_t batch_size = CAPACITY)
+  {
+    auto count = get_shard_count();
+    if(count == 0)
+    {
+      return 0;
+    }
+
+    auto first  = m_next_shard++ % count;
+    size_t read = 0;
+
+    for(size_t i = 0; i < count; ++i)
+    {
+      read += m_shards[(first + i) % count]->sink.read_using(func, batch_size);
+    }
+
+    return read;
+  }
+
+  std::vector<value_type> read(size_t batch_size = CAPACITY)
+  {
+    std::vector<value_type> values;
+    read_using(
+      [&values](value_type* data, size_t size)
+      {
+        values.insert(values.end(), data, data + size);
+        return size;
+      },
+      batch_size);
+
+    return values;
+  }
+
+  /**
+   * Reads all the available values, merged in the order of key(value). Each
+   * producer must write its values in key order; values written after the
+   * call may have smaller keys than the returned ones.
+   */
+  template <typename KeyFunc>
+    requires std::invocable<KeyFunc&, const value_type&>
+  std::vector<value_type> read_merged(KeyFunc key)
+  {
+    std::vector<std::vector<value_type>> runs;
+    size_t total = 0;
+
+    for(size_t i = 0, count = get_shard_count(); i < count; ++i)
+    {
+      auto run = m_shards[i]->sink.read_all();
+      if(!run.empty())
+      {
+        total += run.size();
+        runs.push_back(std::move(run));
+      }
+    }
+
+    // k-way merge with a min heap of the heads of the runs
+    using key_type = std::remove_cvref_t<std::invoke_result_t<KeyFunc&, const value_type&>>;
+    struct head
+    {
+      key_type key;
+      size_t run;
+      size_t index;
+    };
+
+    auto later = [](const head& a, const head& b)
+    {
+      return b.key < a.key || (!(a.key < b.key) && b.run < a.run);
+    };
+
+    std::vector<head> heads;
+    for(size_t i = 0; i < runs.size(); ++i)
+    {
+      heads.push_back({ key(runs[i][0]), i, 0 });
+    }
+    std::make_heap(heads.begin(), heads.end(), later);
+
+    std::vector<value_type> values;
+    values.reserve(total);
+
+    while(!heads.empty())
+    {
+      std::pop_heap(heads.begin(), heads.end(), later);
+      auto& top = heads.back();
+      auto& run = runs[top.run];
+
+      values.push_back(std::move(run[top.index]));
+
+      if(++top.index < run.size())
+      {
+        top.key = key(run[top.index]);
+        std::push_heap(heads.begin(), heads.end(), later);
+      }
+      else
+      {
+        heads.pop_back();
+      }
+    }
+
+    return values;
+  }
+
+  private:
+  struct alignas(64) shard
+  {
+    explicit shard(std::pair<plz::source<buffer_ptr_type>, plz::sink<buffer_ptr_type>> channel)
+      : source{ std::move(channel.first) }, sink{ std::move(channel.second) }
+    {
+    }
+
+    plz::source<buffer_ptr_type> source;
+    plz::sink<buffer_ptr_type> sink;
+
+    // false once the producer thread exited, the shard can then be recycled
+    std::atomic<bool> owned{ true };
+  };
+
+  // Shards of the calling thread, by channel id. Ids are never reused, so an
+  // entry of a destroyed channel is never matched again. The shards are given
+  // back to their channels when the thread exits.
+  struct local_shards
+  {
+    std::vector<std::pair<uint64_t, std::weak_ptr<shard>>> entries;
+
+    ~local_shards()
+    {
+      for(auto& [_, entry] : entries)
+      {
+        if(auto local = entry.lock())
+        {
+          local->owned.store(false, std::memory_order_release);
+        }
+      }
+    }
+  };
+
+  std::shared_ptr<shard> acquire_shard()
+  {
+    std::lock_guard lock(m_mutex);
+
+    auto count = m_shard_count.load(std::memory_order_relaxed);
+
+    // A shard is only recycled once drained, so that every ring stays in the
+    // key order of a single producer for read_merged. The acquire pairs with
+    // the release of the exited thread: its writes to the source happen before
+    // the ones of the new owner
+    for(size_t i = 0; i < count; ++i)
+    {
+      auto& recycled = *m_shards[i];
+      if(!recycled.owned.load(std::memory_order_acquire) &&
+        recycled.sink.get_available_data_size() == 0)
+      {
+        recycled.owned.store(true, std::memory_order_relaxed);
+        return m_shards[i];
+      }
+    }
+
+    if(count == m_shards.size())
+    {
+      throw std::runtime_error("sharded_channel has more producer threads than max_shards");
+    }
+
+    m_shards[count] = std::make_shared<shard>(make_channel(m_make_buffer()));
+
+    // the consumer only looks at the shards below the count
+    m_shard_count.store(count + 1, std::memory_order_release);
+    return m_shards[count];
+  }
+
+  static inline thread_local local_shards s_local_shards;
+
+  const uint64_t m_id = detail::g_sharded_channel_id_counter++;
+  buffer_factory m_make_buffer;
+
+  std::mutex m_mutex;
+  std::vector<std::shared_ptr<shard>> m_shards;
+  std::atomic<size_t> m_shard_count{ 0 };
+
+  size_t m_next_shard{ 0 };
+};
+
+template <typename Factory>
+sharded_channel(Factory, size_t = 64) -> sharded_channel<std::invoke_result_t<Factory&>>;
+
+} // namespace plz
+
+#endif // __SHARDED_CHANNEL_H__
@@ -0,0 +1,463 @@
+#ifndef __SLAB_H__
+#define __SLAB_H__
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include "channel.hpp"
+
+namespace plz
+{
+
+/**
+ * Reference to a value of a plz::slab. Trivially copyable and 4 bytes, so that
+ * channels carry it instead of the value itself.
+ */
+struct slab_handle
+{
+  static constexpr uint32_t INVALID = std::numeric_limits<uint32_t>::max();
+
+  uint32_t index{ INVALID };
+
+  bool is_valid() const
+  {
+    return index != INVALID;
+  }
+
+  friend bool operator==(slab_handle, slab_handle) = default;
+};
+
+/**
+ * Fixed pool of reference counted slots for large messages: a message is
+ * constructed once in a slot, its slab_handle is passed through channels
+ * (e.g. broadcast to all the sinks of an spmc channel) and the slot goes back
+ * to a lock-free free list when the last reference is released. Neither the
+ * writer nor the readers copy the payload.
+ *
+ * The references are managed by hand here; make_slab_channel manages them
+ * for handles sent through a channel.
+ */
+template <typename T>
+class slab
+{
+  public:
+  explicit slab(size_t capacity) : m_capacity{ capacity }
+  {
+    if(capacity == 0 || capacity >= slab_handle::INVALID)
+    {
+      throw std::invalid_argument("slab capacity out of range");
+    }
+
+    m_slots = std::make_unique<slot[]>(capacity);
+    for(size_t i = 0; i < capacity; ++i)
+    {
+      m_slots[i].next.store(i + 1 < capacity ? static_cast<uint32_t>(i + 1) : slab_handle::INVALID,
+        std::memory_order_relaxed);
+    }
+
+    m_free_head.store(pack(0, 0), std::memory_order_relaxed);
+    m_free_count.store(capacity, std::memory_order_relaxed);
+  }
+
+  slab(const slab&)            = delete;
+  slab& operator=(const slab&) = delete;
+
+  ~slab()
+  {
+    for(size_t i = 0; i < m_capacity; ++i)
+    {
+      if(m_slots[i].references.load(std::memory_order_relaxed) > 0)
+      {
+        m_slots[i].get()->~T();
+      }
+    }
+  }
+
+  size_t get_capacity() const
+  {
+    return m_capacity;
+  }
+
+  size_t get_free_count() const
+  {
+    return m_free_count.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Constructs a T from `args` in a free slot, with `references` references
+   * (e.g. the number of sinks it is sent to). Returns std::nullopt when all
+   * the slots are used.
+   */
+  template <typename... Args>
+    requires std::constructible_from<T, Args&&...>
+  std::optional<slab_handle> try_emplace(uint32_t references, Args&&... args)
+  {
+    assert(references > 0);
+
+    auto index = pop_free();
+    if(index == slab_handle::INVALID)
+    {
+      return std::nullopt;
+    }
+
+    auto& current = m_slots[index];
+
+    try
+    {
+      ::new(static_cast<void*>(current.storage)) T(std::forward<Args>(args)...);
+    }
+    catch(...)
+    {
+      push_free(index);
+      throw;
+    }
+
+    current.references.store(references, std::memory_order_release);
+    return slab_handle{ index };
+  }
+
+  T& operator[](slab_handle handle)
+  {
+    return *m_slots[handle.index].get();
+  }
+
+  const T& operator[](slab_handle handle) const
+  {
+    return *m_slots[handle.index].get();
+  }
+
+  /**
+   * Adds `count` references to a value that has at least one.
+   */
+  void retain(slab_handle handle, uint32_t count = 1)
+  {
+    m_slots[handle.index].references.fetch_add(count, std::memory_order_relaxed);
+  }
+
+  /**
+   * Drops a reference, the value is destroyed and its slot freed with the
+   * last one.
+   */
+  void release(slab_handle handle)
+  {
+    auto& current = m_slots[handle.index];
+
+    if(current.references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      current.get()->~T();
+      push_free(handle.index);
+    }
+  }
+
+  private:
+  struct alignas(64) slot
+  {
+    alignas(T) std::byte storage[sizeof(T)];
+    std::atomic<uint32_t> references{ 0 };
+    std::atomic<uint32_t> next{ slab_handle::INVALID };
+
+    T* get()
+    {
+      return std::launder(reinterpret_cast<T*>(storage));
+    }
+  };
+
+  // the head of the free list is tagged with a counter bumped by every pop,
+  // so that a pop racing with a pop and a push of the same slot fails (ABA)
+  static uint64_t pack(uint32_t tag, uint32_t index)
+  {
+    return (static_cast<uint64_t>(tag) << 32) | index;
+  }
+
+  uint32_t pop_free()
+  {
+    auto head = m_free_head.load(std::memory_order_acquire);
+
+    while(true)
+    {
+      auto index = static_cast<uint32_t>(head);
+      if(index == slab_handle::INVALID)
+      {
+        return slab_handle::INVALID;
+      }
+
+      auto next = m_slots[index].next.load(std::memory_order_relaxed);
+      auto tag  = static_cast<uint32_t>(head >> 32);
+
+      if(m_free_head.compare_exchange_weak(
+           head, pack(tag + 1, next), std::memory_order_acq_rel, std::memory_order_acquire))
+      {
+        m_free_count.fetch_sub(1, std::memory_order_relaxed);
+        return index;
+      }
+    }
+  }
+
+  void push_free(uint32_t index)
+  {
+    auto head = m_free_head.load(std::memory_order_relaxed);
+
+    while(true)
+    {
+      m_slots[index].next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+
+      if(m_free_head.compare_exchange_weak(head,
+           pack(static_cast<uint32_t>(head >> 32), index),
+           std::memory_order_release,
+           std::memory_order_relaxed))
+      {
+        m_free_count.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+    }
+  }
+
+  size_t m_capacity;
+  std::unique_ptr<slot[]> m_slots;
+
+  alignas(64) std::atomic<uint64_t> m_free_head;
+  std::atomic<size_t> m_free_count;
+};
+
+/**
+ * Reference to a value of a plz::slab that releases it when destroyed. Copies
+ * hold their own reference.
+ */
+template <typename T>
+class slab_ref
+{
+  public:
+  slab_ref() = default;
+
+  // takes over a reference the caller already holds
+  slab_ref(slab<T>& values, slab_handle handle) : m_slab{ &values }, m_handle{ handle }
+  {
+  }
+
+  slab_ref(const slab_ref& other) : m_slab{ other.m_slab }, m_handle{ other.m_handle }
+  {
+    if(m_handle.is_valid())
+    {
+      m_slab->retain(m_handle);
+    }
+  }
+
+  slab_ref(slab_ref&& other) noexcept
+    : m_slab{ other.m_slab }, m_handle{ std::exchange(other.m_handle, slab_handle{}) }
+  {
+  }
+
+  slab_ref& operator=(slab_ref other) noexcept
+  {
+    std::swap(m_slab, other.m_slab);
+    std::swap(m_handle, other.m_handle);
+    return *this;
+  }
+
+  ~slab_ref()
+  {
+    if(m_handle.is_valid())
+    {
+      m_slab->release(m_handle);
+    }
+  }
+
+  slab_handle get_handle() const
+  {
+    return m_handle;
+  }
+
+  const T& operator*() const
+  {
+    return (*m_slab)[m_handle];
+  }
+
+  const T* operator->() const
+  {
+    return &(*m_slab)[m_handle];
+  }
+
+  private:
+  slab<T>* m_slab{ nullptr };
+  slab_handle m_handle;
+};
+
+/**
+ * Writing end of a slab channel, see make_slab_channel. Only one thread may
+ * write to it.
+ */
+template <typename T, circular_buffer_ptr BufferPointer>
+class slab_source
+{
+  public:
+  static constexpr size_t CAPACITY = source<BufferPointer>::CAPACITY;
+
+  slab_source(slab<T>& values, source<BufferPointer> output, BufferPointer buffer)
+    : m_slab{ &values }, m_source{ std::move(output) }, m_buffer{ std::move(buffer) }
+  {
+  }
+
+  slab_source(slab_source&&)            = default;
+  slab_source& operator=(slab_source&&) = default;
+
+  /**
+   * Constructs a T from `args` in the slab and sends its handle to all the
+   * sinks. Returns false, without constructing anything, when a sink did not
+   * read the handle that would be overwritten or the slab is full.
+   */
+  template <typename... Args>
+    requires std::constructible_from<T, Args&&...>
+  bool try_publish(Args&&... args)
+  {
+    reclaim();
+
+    if(m_source.get_free_space() == 0)
+    {
+      return false;
+    }
+
+    // the reference of the ring, released by reclaim
+    auto handle = m_slab->try_emplace(1, std::forward<Args>(args)...);
+    if(!handle)
+    {
+      return false;
+    }
+
+    m_source.put(*handle);
+    m_written++;
+    return true;
+  }
+
+  /**
+   * Releases the references of the ring to the values that every sink read.
+   * try_publish calls it, a writer that stops publishing can call it to give
+   * the slots back earlier.
+   */
+  void reclaim()
+  {
+    // unbounded free space when there is no sink: everything can go
+    auto unread = CAPACITY - std::min(CAPACITY, m_source.get_free_space());
+
+    while(m_written - m_reclaimed > unread)
+    {
+      m_slab->release((*m_buffer)[m_reclaimed % CAPACITY]);
+      m_reclaimed++;
+    }
+  }
+
+  void close()
+  {
+    m_source.close();
+  }
+
+  private:
+  slab<T>* m_slab;
+  source<BufferPointer> m_source;
+  BufferPointer m_buffer;
+
+  size_t m_written{ 0 };
+  size_t m_reclaimed{ 0 };
+};
+
+/**
+ * Reading end of a slab channel, see make_slab_channel. A copy is another
+ * sink of the channel, like for plz::sink.
+ */
+template <typename T, circular_buffer_ptr BufferPointer>
+class slab_sink
+{
+  public:
+  slab_sink(slab<T>& values, sink<BufferPointer> input)
+    : m_slab{ &values }, m_sink{ std::move(input) }
+  {
+  }
+
+  /**
+   * Next value of the channel, or std::nullopt if the sink is empty.
+   */
+  std::optional<slab_ref<T>> try_get()
+  {
+    if(m_sink.get_available_data_size() == 0)
+    {
+      return std::nullopt;
+    }
+
+    // the reference is taken before the read index moves past the handle,
+    // the writer may release the reference of the ring right after
+    std::optional<slab_ref<T>> value;
+    m_sink.read_using(
+      [this, &value](slab_handle* handles, size_t)
+      {
+        m_slab->retain(handles[0]);
+        value.emplace(*m_slab, handles[0]);
+        return size_t{ 1 };
+      },
+      1);
+
+    return value;
+  }
+
+  size_t get_available_data_size() const
+  {
+    return m_sink.get_available_data_size();
+  }
+
+  bool is_closed() const
+  {
+    return m_sink.is_closed();
+  }
+
+  private:
+  slab<T>* m_slab;
+  sink<BufferPointer> m_sink;
+};
+
+/**
+ * Channel of slab handles with SINKS_COUNT sinks that manages the references:
+ * the ring holds one reference to each value until every sink read it, and
+ * the values come out of the sinks as slab_ref. Sinks can be copied or
+ * destroyed at any time, and the writer never overwrites a handle that a sink
+ * did not read. Values still in the ring when the channel is gone are
+ * destroyed with the slab, which must outlive the channel.
+ *
+ * ```
+ * plz::slab<frame> frames(256);
+ * auto [source, sinks] = plz::make_slab_channel<3>(frames, std::make_shared<std::array<plz::slab_handle, 256>>());
+ *
+ * // writer
+ * source.try_publish(width, height);
+ *
+ * // every reader
+ * if(auto frame = sinks[i].try_get())
+ *   process(**frame);
+ * ```
+ */
+template <size_t SINKS_COUNT, typename T, circular_buffer_ptr BufferPointer>
+  requires std::same_as<typename source<BufferPointer>::value_type, slab_handle>
+auto make_slab_channel(slab<T>& values, BufferPointer buffer_ptr)
+  -> std::pair<slab_source<T, BufferPointer>, std::array<slab_sink<T, BufferPointer>, SINKS_COUNT>>
+{
+  auto buffer          = buffer_ptr;
+  auto [output, sinks] = make_spmc_channel<SINKS_COUNT>(std::move(buffer_ptr));
+
+  return { slab_source<T, BufferPointer>(values, std::move(output), std::move(buffer)),
+    [&]<size_t... I>(std::index_sequence<I...>)
+    {
+      return std::array<slab_sink<T, BufferPointer>, SINKS_COUNT>{ slab_sink<T, BufferPointer>(
+        values, std::move(sinks[I]))... };
+    }(std::make_index_sequence<SINKS_COUNT>()) };
+}
+
+} // namespace plz
+
+#endif // __SLAB_H__
@@ -0,0 +1,50 @@
+#ifndef __CIRCBUFF_TRANSFER_H__
+#define __CIRCBUFF_TRANSFER_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+namespace plz::circbuff
+{
+
+// Types the rings can hold: the slots are live objects that the writer copy
+// assigns and every reader copies from, a move-only type can't be shared
+template <typename T>
+concept transferable_element = std::is_copy_constructible_v<T> && std::is_copy_assignable_v<T>;
+
+// Copies `count` elements to live objects: a memcpy for trivially copyable
+// types, a copy assignment of every element otherwise.
+template <typename T>
+void copy_elements(T* destination, const T* source, size_t count)
+{
+  if constexpr(std::is_trivially_copyable_v<T>)
+  {
+    std::memcpy(destination, source, count * sizeof(T));
+  }
+  else
+  {
+    std::copy_n(source, count, destination);
+  }
+}
+
+// Same as copy_elements, but moves from `source` when the type is not
+// trivially copyable
+template <typename T>
+void move_elements(T* destination, T* source, size_t count)
+{
+  if constexpr(std::is_trivially_copyable_v<T>)
+  {
+    std::memcpy(destination, source, count * sizeof(T));
+  }
+  else
+  {
+    std::copy_n(std::make_move_iterator(source), count, destination);
+  }
+}
+
+} // namespace plz::circbuff
+
+#endif // __CIRCBUFF_TRANSFER_H__
@@ -0,0 +1,499 @@
+#ifndef __WINDOW_H__
+#define __WINDOW_H__
+
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "channel.hpp"
+
+namespace plz
+{
+
+/**
+ * Aggregators of the window operators. An aggregator is a monoid over
+ * `result_type`: `identity()`, `lift(input)` that turns an input value into a
+ * result and an associative `combine(older, newer)`. Aggregators with an
+ * `inverse(total, evicted)` (count, sum) let sliding windows subtract the
+ * evicted values instead of keeping partial aggregates.
+ */
+namespace aggregate
+{
+
+template <typename T>
+struct count
+{
+  using input_type  = T;
+  using result_type = size_t;
+
+  size_t identity() const
+  {
+    return 0;
+  }
+
+  size_t lift(const T&) const
+  {
+    return 1;
+  }
+
+  size_t combine(size_t older, size_t newer) const
+  {
+    return older + newer;
+  }
+
+  size_t inverse(size_t total, size_t evicted) const
+  {
+    return total - evicted;
+  }
+};
+
+template <typename T>
+struct sum
+{
+  using input_type  = T;
+  using result_type = T;
+
+  T identity() const
+  {
+    return T{};
+  }
+
+  T lift(const T& value) const
+  {
+    return value;
+  }
+
+  T combine(const T& older, const T& newer) const
+  {
+    return older + newer;
+  }
+
+  T inverse(const T& total, const T& evicted) const
+  {
+    return total - evicted;
+  }
+};
+
+template <typename T>
+struct min
+{
+  using input_type  = T;
+  using result_type = T;
+
+  T identity() const
+  {
+    return std::numeric_limits<T>::max();
+  }
+
+  T lift(const T& value) const
+  {
+    return value;
+  }
+
+  T combine(const T& older, const T& newer) const
+  {
+    return newer < older ? newer : older;
+  }
+};
+
+template <typename T>
+struct max
+{
+  using input_type  = T;
+  using result_type = T;
+
+  T identity() const
+  {
+    return std::numeric_limits<T>::lowest();
+  }
+
+  T lift(const T& value) const
+  {
+    return value;
+  }
+
+  T combine(const T& older, const T& newer) const
+  {
+    return older < newer ? newer : older;
+  }
+};
+
+/**
+ * User defined aggregator: `lift` turns an input value into a Result and
+ * `combine` must be associative with `identity` as neutral element.
+ */
+template <typename T, typename Result, typename Lift, typename Combine>
+  requires std::invocable<const Lift&, const T&> &&
+  std::invocable<const Combine&, const Result&, const Result&>
+struct reducer
+{
+  using input_type  = T;
+  using result_type = Result;
+
+  Result m_identity;
+  Lift m_lift;
+  Combine m_combine;
+
+  Result identity() const
+  {
+    return m_identity;
+  }
+
+  Result lift(const T& value) const
+  {
+    return std::invoke(m_lift, value);
+  }
+
+  Result combine(const Result& older, const Result& newer) const
+  {
+    return std::invoke(m_combine, older, newer);
+  }
+};
+
+template <typename T, typename Result, typename Lift, typename Combine>
+reducer<T, Result, Lift, Combine> reduce(Result identity, Lift lift, Combine combine)
+{
+  return { std::move(identity), std::move(lift), std::move(combine) };
+}
+
+} // namespace aggregate
+
+template <typename T>
+concept aggregator = requires(const T& aggregator,
+  const typename T::input_type& value,
+  const typename T::result_type& result) {
+  {
+    aggregator.identity()
+  } -> std::convertible_to<typename T::result_type>;
+  {
+    aggregator.lift(value)
+  } -> std::convertible_to<typename T::result_type>;
+  {
+    aggregator.combine(result, result)
+  } -> std::convertible_to<typename T::result_type>;
+};
+
+template <typename T>
+concept invertible_aggregator = aggregator<T> && requires(const T& aggregator,
+  const typename T::result_type& result) {
+  {
+    aggregator.inverse(result, result)
+  } -> std::convertible_to<typename T::result_type>;
+};
+
+namespace detail
+{
+
+// Feeds the available values of `input` to window.process, span by span
+template <circular_buffer_ptr BufferPointer, typename Window>
+size_t drain_into(sink<BufferPointer>& input, Window& window, size_t max_count)
+{
+  return input.read_using(
+    [&window](typename sink<BufferPointer>::value_type* values, size_t count)
+    {
+      window.process(values, count);
+      return count;
+    },
+    max_count);
+}
+
+} // namespace detail
+
+/**
+ * Aggregates consecutive, non overlapping windows of `size` values and puts
+ * the result of each full window in `output`.
+ *
+ * ```
+ * plz::tumbling_window<plz::aggregate::sum<double>, out_buffer_ptr> per_second(1000, totals);
+ * per_second.drain(samples);
+ * ```
+ */
+template <aggregator Aggregator, circular_buffer_ptr OutputPointer>
+class tumbling_window
+{
+  public:
+  using input_type  = typename Aggregator::input_type;
+  using result_type = typename Aggregator::result_type;
+
+  tumbling_window(size_t size, source<OutputPointer>& output, Aggregator aggregator = {})
+    : m_size{ size }, m_output{ &output }, m_aggregator{ std::move(aggregator) },
+      m_result{ m_aggregator.identity() }
+  {
+    if(size == 0)
+    {
+      throw std::invalid_argument("window size must be positive");
+    }
+  }
+
+  void push(const input_type& value)
+  {
+    m_result = m_aggregator.combine(m_result, m_aggregator.lift(value));
+
+    if(++m_count == m_size)
+    {
+      flush();
+    }
+  }
+
+  void process(const input_type* values, size_t count)
+  {
+    for(size_t i = 0; i < count; ++i)
+    {
+      push(values[i]);
+    }
+  }
+
+  template <circular_buffer_ptr BufferPointer>
+  size_t drain(sink<BufferPointer>& input, size_t max_count = std::numeric_limits<size_t>::max())
+  {
+    return detail::drain_into(input, *this, max_count);
+  }
+
+  /**
+   * Emits the aggregate of the current window if it has values, even if it is
+   * not full.
+   */
+  void flush()
+  {
+    if(m_count == 0)
+    {
+      return;
+    }
+
+    m_output->put(std::exchange(m_result, m_aggregator.identity()));
+    m_count = 0;
+  }
+
+  private:
+  size_t m_size;
+  source<OutputPointer>* m_output;
+  Aggregator m_aggregator;
+  result_type m_result;
+  size_t m_count{ 0 };
+};
+
+/**
+ * Aggregates the last `size` values and puts the result in `output` every
+ * `step` values once the window is full. Every value costs O(1) amortized:
+ * invertible aggregators subtract the evicted value from the running total,
+ * the others use two stacks of partial aggregates (the older stack is rebuilt
+ * from the newer one every `size` evictions).
+ */
+template <aggregator Aggregator, circular_buffer_ptr OutputPointer>
+class sliding_window
+{
+  public:
+  using input_type  = typename Aggregator::input_type;
+  using result_type = typename Aggregator::result_type;
+
+  sliding_window(size_t size, source<OutputPointer>& output, size_t step = 1, Aggregator aggregator = {})
+    : m_size{ size }, m_step{ step }, m_output{ &output }, m_aggregator{ std::move(aggregator) },
+      m_back_result{ m_aggregator.identity() }
+  {
+    if(size == 0 || step == 0)
+    {
+      throw std::invalid_argument("window size and step must be positive");
+    }
+  }
+
+  void push(const input_type& value)
+  {
+    auto lifted = m_aggregator.lift(value);
+
+    if constexpr(invertible_aggregator<Aggregator>)
+    {
+      m_lifted.push_back(lifted);
+      m_back_result = m_aggregator.combine(m_back_result, lifted);
+
+      if(m_lifted.size() - m_head > m_size)
+      {
+        m_back_result = m_aggregator.inverse(m_back_result, m_lifted[m_head++]);
+        compact();
+      }
+    }
+    else
+    {
+      m_back.push_back(lifted);
+      m_back_result = m_aggregator.combine(m_back_result, lifted);
+
+      if(m_front.size() + m_back.size() > m_size)
+      {
+        evict();
+      }
+    }
+
+    if(++m_seen >= m_size && (m_seen - m_size) % m_step == 0)
+    {
+      m_output->put(result());
+    }
+  }
+
+  void process(const input_type* values, size_t count)
+  {
+    for(size_t i = 0; i < count; ++i)
+    {
+      push(values[i]);
+    }
+  }
+
+  template <circular_buffer_ptr BufferPointer>
+  size_t drain(sink<BufferPointer>& input, size_t max_count = std::numeric_limits<size_t>::max())
+  {
+    return detail::drain_into(input, *this, max_count);
+  }
+
+  /**
+   * Aggregate of the values currently in the window.
+   */
+  result_type result() const
+  {
+    if constexpr(invertible_aggregator<Aggregator>)
+    {
+      return m_back_result;
+    }
+    else
+    {
+      if(m_front.empty())
+      {
+        return m_back_result;
+      }
+
+      return m_aggregator.combine(m_front.back(), m_back_result);
+    }
+  }
+
+  private:
+  // moves the newer stack to the older one, where every entry aggregates
+  // itself and all the newer values of the stack, then pops the oldest
+  void evict()
+  {
+    if(m_front.empty())
+    {
+      auto result = m_aggregator.identity();
+      for(auto it = m_back.rbegin(); it != m_back.rend(); ++it)
+      {
+        result = m_aggregator.combine(*it, result);
+        m_front.push_back(result);
+      }
+
+      m_back.clear();
+      m_back_result = m_aggregator.identity();
+    }
+
+    m_front.pop_back();
+  }
+
+  // drops the evicted values once they are half of the storage
+  void compact()
+  {
+    if(m_head >= m_size)
+    {
+      m_lifted.erase(m_lifted.begin(), m_lifted.begin() + static_cast<std::ptrdiff_t>(m_head));
+      m_head = 0;
+    }
+  }
+
+  size_t m_size;
+  size_t m_step;
+  source<OutputPointer>* m_output;
+  Aggregator m_aggregator;
+  size_t m_seen{ 0 };
+
+  // invertible aggregators: lifted values in the window from m_head, and
+  // their total in m_back_result
+  std::vector<result_type> m_lifted;
+  size_t m_head{ 0 };
+
+  // other aggregators: older values as suffix aggregates (oldest on top) and
+  // newer values with their total in m_back_result
+  std::vector<result_type> m_front;
+  std::vector<result_type> m_back;
+  result_type m_back_result;
+};
+
+/**
+ * Aggregates sessions of values and puts the result of each one in `output`
+ * when it ends: a session ends when the next value comes more than `gap` after
+ * the previous one, according to `time_of(value)`.
+ *
+ * ```
+ * plz::session_window<plz::aggregate::count<click>, out_buffer_ptr, time_of_click>
+ *   sessions(30s, clicks_per_session, time_of_click{});
+ * ```
+ */
+template <aggregator Aggregator, circular_buffer_ptr OutputPointer, typename TimeOf>
+  requires std::invocable<const TimeOf&, const typename Aggregator::input_type&>
+class session_window
+{
+  public:
+  using input_type  = typename Aggregator::input_type;
+  using result_type = typename Aggregator::result_type;
+  using time_type =
+    std::remove_cvref_t<std::invoke_result_t<const TimeOf&, const input_type&>>;
+  using gap_type = decltype(std::declval<time_type>() - std::declval<time_type>());
+
+  session_window(gap_type gap, source<OutputPointer>& output, TimeOf time_of = {}, Aggregator aggregator = {})
+    : m_gap{ gap }, m_output{ &output }, m_time_of{ std::move(time_of) },
+      m_aggregator{ std::move(aggregator) }, m_result{ m_aggregator.identity() }
+  {
+  }
+
+  void push(const input_type& value)
+  {
+    auto time = std::invoke(m_time_of, value);
+
+    if(m_open && time - m_last_time > m_gap)
+    {
+      flush();
+    }
+
+    m_result    = m_aggregator.combine(m_result, m_aggregator.lift(value));
+    m_last_time = time;
+    m_open      = true;
+  }
+
+  void process(const input_type* values, size_t count)
+  {
+    for(size_t i = 0; i < count; ++i)
+    {
+      push(values[i]);
+    }
+  }
+
+  template <circular_buffer_ptr BufferPointer>
+  size_t drain(sink<BufferPointer>& input, size_t max_count = std::numeric_limits<size_t>::max())
+  {
+    return detail::drain_into(input, *this, max_count);
+  }
+
+  /**
+   * Ends the current session, if any, and emits its aggregate.
+   */
+  void flush()
+  {
+    if(!m_open)
+    {
+      return;
+    }
+
+    m_output->put(std::exchange(m_result, m_aggregator.identity()));
+    m_open = false;
+  }
+
+  private:
+  gap_type m_gap;
+  source<OutputPointer>* m_output;
+  TimeOf m_time_of;
+  Aggregator m_aggregator;
+  result_type m_result;
+  time_type m_last_time{};
+  bool m_open{ false };
+};
+
+} // namespace plz
+
+#endif // __WINDOW_H__
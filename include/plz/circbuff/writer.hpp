@@ -2,12 +2,13 @@
 #define ____CIRCBUFF_CIRCULAR_WRITER_H__
 
 #include <cassert>
-#include <cstring>
+#include <memory>
 #include <type_traits>
 
 #include "plz/help/type_traits.hpp"
 
 #include "concepts.hpp"
+#include "transfer.hpp"
 
 namespace plz::circbuff
 {
@@ -28,6 +29,9 @@ class writer
   using value_type =
     typename array_traits<typename std::pointer_traits<BufferPointer>::element_type>::value_type;
 
+  static_assert(transferable_element<value_type>,
+    "circbuff elements are copied to every reader of the buffer, move-only types are not supported");
+
   std::conditional_t<g_has_min_contiguous_size, std::unique_ptr<std::array<value_type, g_min_contiguous_size>>, void*> m_min_contiguous_buffer =
     nullptr;
 
@@ -82,13 +86,39 @@ class writer
     m_index++;
   }
 
+  /**
+   * Constructs a value from `args` directly in the next slot of the buffer, in
+   * place of the value it holds. Types whose construction may throw are
+   * constructed aside and move assigned, so that the slot always holds a
+   * live value.
+   */
+  template <typename... Args>
+    requires std::constructible_from<value_type, Args&&...> &&
+    ((!g_has_min_contiguous_size) || (g_min_contiguous_size == 1))
+  void emplace(Args&&... args)
+  {
+    auto slot = m_buffer->data() + (m_index & g_modmask);
+
+    if constexpr(std::is_nothrow_constructible_v<value_type, Args&&...>)
+    {
+      std::destroy_at(slot);
+      std::construct_at(slot, std::forward<Args>(args)...);
+    }
+    else
+    {
+      *slot = value_type(std::forward<Args>(args)...);
+    }
+
+    m_index++;
+  }
+
   void write(const value_type* values, size_t count)
   {
     size_t offset = 0;
     write_using(
       [&offset, values](value_type* data, size_t size)
       {
-        std::memcpy(data, values + offset, size * sizeof(value_type));
+        copy_elements(data, values + offset, size);
         offset += size;
         return size;
       },
@@ -161,9 +191,7 @@ class writer
     auto written =
       std::min(func(m_min_contiguous_buffer->data(), g_min_contiguous_size), count);
 
-    std::memcpy(m_buffer->data() + index,
-      m_min_contiguous_buffer->data(),
-      written * sizeof(value_type));
+    move_elements(m_buffer->data() + index, m_min_contiguous_buffer->data(), written);
 
     return written;
   }
@@ -0,0 +1,328 @@
+#ifndef __FORK_JOIN_H__
+#define __FORK_JOIN_H__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "thread_pool.hpp"
+
+namespace plz
+{
+
+/**
+ * Scope of fork/join parallelism on a thread_pool: `spawn` forks children,
+ * `sync` waits for all the children spawned so far and rethrows the first
+ * exception one of them threw.
+ *
+ * Children spawned from a worker go on that worker's local queue, which the
+ * worker pops most recent first and the idle workers steal from oldest first,
+ * without taking the pool mutex. A child costs no promise, future or
+ * std::function: it lives in the scope (in place for small callables) and is
+ * joined with the scope's counter. A worker waiting in `sync` runs the
+ * children left in its queue, then steals from the other workers, instead of
+ * blocking. Children still queued when the pool quits run before the workers
+ * exit.
+ *
+ * The scope is meant to live on the stack of the thread that spawns from it,
+ * the destructor syncs (dropping the exceptions).
+ *
+ * ```
+ * long fib(long n)
+ * {
+ *   if(n < 20) return serial_fib(n);
+ *   long a, b;
+ *   plz::fork_join scope;
+ *   scope.spawn([&] { a = fib(n - 1); });
+ *   b = fib(n - 2);
+ *   scope.sync();
+ *   return a + b;
+ * }
+ * ```
+ */
+class fork_join
+{
+  public:
+  // the pool of the calling worker, or the global instance outside a pool
+  fork_join()
+    : fork_join(detail::g_current_worker.pool ? *detail::g_current_worker.pool
+                                              : thread_pool::global_instance())
+  {
+  }
+
+  explicit fork_join(thread_pool& pool) : m_pool{ &pool }
+  {
+  }
+
+  fork_join(const fork_join&)            = delete;
+  fork_join& operator=(const fork_join&) = delete;
+
+  ~fork_join()
+  {
+    try
+    {
+      sync();
+    }
+    catch(...)
+    {
+    }
+  }
+
+  template <typename Func>
+    requires std::invocable<std::decay_t<Func>&>
+  void spawn(Func&& func)
+  {
+    using child_type = child_impl<std::decay_t<Func>>;
+
+    auto [memory, heap_alignment] = allocate(sizeof(child_type), alignof(child_type));
+    auto child = ::new(memory) child_type(this, std::forward<Func>(func));
+
+    child->heap_alignment = heap_alignment;
+    child->next           = m_children;
+    m_children            = child;
+
+    // the scope holds one count of its own until sync, so that children done
+    // before the next spawn do not release it
+    m_pending.fetch_add(m_unsynced_count++ == 0 ? 2 : 1, std::memory_order_relaxed);
+
+    try
+    {
+      m_pool->push_fork_task(child);
+    }
+    catch(...)
+    {
+      m_children = child->next;
+      destroy_child(child);
+
+      child_done();
+      throw;
+    }
+  }
+
+  void sync()
+  {
+    if(m_unsynced_count == 0)
+    {
+      return;
+    }
+
+    child_done();
+
+    {
+      // the last child sets m_released under the mutex, so it is done with the
+      // scope once we get it
+      std::unique_lock lock(m_mutex);
+
+      if(m_pool->is_current_worker())
+      {
+        // a worker keeps running children, its own first then stolen ones,
+        // and only naps while the children it waits for run elsewhere
+        while(!m_released)
+        {
+          lock.unlock();
+          bool ran = m_pool->run_fork_task();
+          lock.lock();
+
+          if(!ran)
+          {
+            m_condition.wait_for(lock,
+              s_steal_interval,
+              [this]
+              {
+                return m_released;
+              });
+          }
+        }
+      }
+      else
+      {
+        m_condition.wait(lock,
+          [this]
+          {
+            return m_released;
+          });
+      }
+
+      m_released = false;
+    }
+
+    m_unsynced_count = 0;
+    release_children();
+
+    if(m_exception)
+    {
+      m_has_exception.store(false, std::memory_order_relaxed);
+      std::rethrow_exception(std::exchange(m_exception, nullptr));
+    }
+  }
+
+  private:
+  struct child : detail::fork_task
+  {
+    fork_join* scope;
+    child* next{ nullptr };
+    size_t heap_alignment{ 0 }; // 0 when stored in the scope
+    void (*destroy)(child*);
+  };
+
+  template <typename Func>
+  struct child_impl : child
+  {
+    Func func;
+
+    template <typename F>
+    child_impl(fork_join* owner, F&& f) : func(std::forward<F>(f))
+    {
+      this->execute = &child_impl::run;
+      this->destroy = &child_impl::destroy_self;
+      this->scope   = owner;
+    }
+
+    static void run(detail::fork_task* task)
+    {
+      auto self = static_cast<child_impl*>(task);
+
+      try
+      {
+        std::invoke(self->func);
+      }
+      catch(...)
+      {
+        self->scope->set_exception(std::current_exception());
+      }
+
+      self->scope->child_done();
+    }
+
+    static void destroy_self(child* self)
+    {
+      static_cast<child_impl*>(self)->~child_impl();
+    }
+  };
+
+  std::pair<void*, size_t> allocate(size_t size, size_t alignment)
+  {
+    auto offset = (m_storage_used + alignment - 1) / alignment * alignment;
+
+    if(alignment <= alignof(std::max_align_t) && offset + size <= s_storage_size)
+    {
+      m_storage_used = offset + size;
+      return { m_storage + offset, 0 };
+    }
+
+    return { ::operator new(size, std::align_val_t(alignment)), alignment };
+  }
+
+  static void destroy_child(child* child)
+  {
+    auto heap_alignment = child->heap_alignment;
+    auto memory         = static_cast<void*>(child);
+
+    child->destroy(child);
+
+    if(heap_alignment != 0)
+    {
+      ::operator delete(memory, std::align_val_t(heap_alignment));
+    }
+  }
+
+  void release_children()
+  {
+    while(m_children != nullptr)
+    {
+      destroy_child(std::exchange(m_children, m_children->next));
+    }
+
+    m_storage_used = 0;
+  }
+
+  void set_exception(std::exception_ptr exception)
+  {
+    if(!m_has_exception.exchange(true, std::memory_order_relaxed))
+    {
+      m_exception = std::move(exception);
+    }
+  }
+
+  void child_done()
+  {
+    if(m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      std::lock_guard lock(m_mutex);
+      m_released = true;
+      m_condition.notify_all();
+    }
+  }
+
+  // children up to this size in total are stored in the scope itself
+  static constexpr size_t s_storage_size = 256;
+
+  // how long a worker waiting in sync naps before it tries to steal again
+  static constexpr std::chrono::microseconds s_steal_interval{ 50 };
+
+  thread_pool* m_pool;
+
+  std::atomic<size_t> m_pending{ 0 };
+  size_t m_unsynced_count{ 0 };
+
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_released{ false };
+
+  std::atomic<bool> m_has_exception{ false };
+  std::exception_ptr m_exception;
+
+  child* m_children{ nullptr };
+  size_t m_storage_used{ 0 };
+  alignas(std::max_align_t) std::byte m_storage[s_storage_size];
+};
+
+/**
+ * Runs the given callables in parallel on `pool` and returns once they are
+ * all done. The calling thread runs the first one itself, the others are
+ * spawned as fork_join children. Rethrows the first exception thrown.
+ */
+template <typename... Funcs>
+  requires(sizeof...(Funcs) > 0 && (std::invocable<Funcs&> && ...))
+void parallel_invoke(thread_pool& pool, Funcs&&... funcs)
+{
+  fork_join scope(pool);
+
+  [&scope](auto& first, auto&... others)
+  {
+    (scope.spawn(
+       [&others]
+       {
+         std::invoke(others);
+       }),
+      ...);
+
+    std::invoke(first);
+  }(funcs...);
+
+  scope.sync();
+}
+
+/**
+ * parallel_invoke on the pool of the calling worker, or on the global instance
+ * outside a pool.
+ */
+template <typename... Funcs>
+  requires(sizeof...(Funcs) > 0 && (std::invocable<Funcs&> && ...))
+void parallel_invoke(Funcs&&... funcs)
+{
+  parallel_invoke(detail::g_current_worker.pool ? *detail::g_current_worker.pool
+                                                : thread_pool::global_instance(),
+    std::forward<Funcs>(funcs)...);
+}
+
+} // namespace plz
+
+#endif // __FORK_JOIN_H__
@@ -3,17 +3,24 @@
 
 // stl headers
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <concepts>
 #include <condition_variable>
 #include <exception>
 #include <expected>
 #include <functional>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <stdexcept>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
+#include "plz/help/callable.hpp"
 #include "plz/help/type_traits.hpp"
 
 namespace plz
@@ -44,12 +51,129 @@ promise<T> make_promise() noexcept;
 namespace detail
 {
 
+// Posts a task on a thread_pool. The pool stores it in the shared states it
+// binds, next to itself, so that they can hand work to it without depending on
+// the thread_pool definition.
+using post_on_pool_function = void (*)(thread_pool*, const plz::callable<void()>&);
+
+// Watchdog slots of the thread_pool worker running on the calling thread (null
+// on other threads): the "blocked since" slot of the worker and the flag telling
+// whether the watchdog of its pool is running.
+struct worker_wait_slot
+{
+  std::atomic<int64_t>* wait_start{ nullptr };
+  const std::atomic<bool>* watchdog_enabled{ nullptr };
+};
+
+inline thread_local worker_wait_slot g_worker_wait;
+
+// Marks the calling thread_pool worker as blocked on a future while it is
+// alive, so that the pool watchdog can report workers stuck in get(). Costs a
+// thread local read when the watchdog is not running.
+struct worker_wait_guard
+{
+  worker_wait_guard()
+  {
+    if(g_worker_wait.wait_start && g_worker_wait.watchdog_enabled->load(std::memory_order_relaxed))
+    {
+      m_slot = g_worker_wait.wait_start;
+      m_slot->store(std::chrono::steady_clock::now().time_since_epoch().count(),
+        std::memory_order_relaxed);
+    }
+  }
+
+  ~worker_wait_guard()
+  {
+    if(m_slot)
+    {
+      m_slot->store(0, std::memory_order_relaxed);
+    }
+  }
+
+  worker_wait_guard(const worker_wait_guard&)            = delete;
+  worker_wait_guard& operator=(const worker_wait_guard&) = delete;
+
+  private:
+  std::atomic<int64_t>* m_slot{ nullptr };
+};
+
+// Success handlers of a shared state split in shards of `shard_size` handlers.
+// The shards are claimed one at a time, by the pool tasks of the parallel
+// dispatch and by the threads waiting for the future, so that a waiting thread
+// helps instead of depending on free workers.
+template <typename Handler>
+class handler_shards
+{
+  public:
+  handler_shards(std::vector<Handler>&& handlers, size_t shard_size)
+    : m_handlers{ std::move(handlers) }, m_shard_size{ shard_size }
+  {
+  }
+
+  size_t get_count() const
+  {
+    return (m_handlers.size() + m_shard_size - 1) / m_shard_size;
+  }
+
+  // Runs up to `max_count` unclaimed shards with `invoke` and adds their number
+  // to `ran`, the shard of a throwing handler included.
+  template <typename Invoke>
+  void run(Invoke&& invoke, size_t& ran, size_t max_count = std::numeric_limits<size_t>::max())
+  {
+    for(size_t i = 0; i < max_count; ++i)
+    {
+      auto shard = m_next.fetch_add(1, std::memory_order_relaxed);
+      if(shard >= get_count())
+      {
+        return;
+      }
+
+      ran++;
+
+      auto end = std::min((shard + 1) * m_shard_size, m_handlers.size());
+      for(auto handler = shard * m_shard_size; handler < end; ++handler)
+      {
+        invoke(m_handlers[handler]);
+      }
+    }
+  }
+
+  private:
+  std::vector<Handler> m_handlers;
+  size_t m_shard_size;
+  std::atomic<size_t> m_next{ 0 };
+};
+
+// Shared state whose success handlers the calling thread is running, if any:
+// a handler that calls get() on its own future must not wait for the shard it
+// is running.
+inline thread_local const void* g_running_handlers_of{ nullptr };
+
+struct running_handlers_guard
+{
+  explicit running_handlers_guard(const void* state)
+    : m_previous{ std::exchange(g_running_handlers_of, state) }
+  {
+  }
+
+  ~running_handlers_guard()
+  {
+    g_running_handlers_of = m_previous;
+  }
+
+  running_handlers_guard(const running_handlers_guard&)            = delete;
+  running_handlers_guard& operator=(const running_handlers_guard&) = delete;
+
+  private:
+  const void* m_previous;
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 /// Internal class that holds the shared state of the future/promise objects //
 ///////////////////////////////////////////////////////////////////////////////
 
 template <typename T>
-class state
+class state : public std::enable_shared_from_this<state<T>>
 {
   template <typename X>
   friend class plz::future;
@@ -74,8 +198,164 @@ class state
   std::vector<std::function<bool(const std::exception_ptr&)>> m_exceptions_handlers;
 
   thread_pool* m_pool{};
+  post_on_pool_function m_post_on_pool{};
+
+  using shards_type = handler_shards<std::function<void(const result_type&)>>;
+
+  // success handlers are dispatched on m_pool when there are more than
+  // m_fan_out_threshold of them (0 disables the parallel dispatch)
+  size_t m_fan_out_threshold{ 0 };
+  size_t m_fan_out_shard_size{ 1 };
+
+  // shards of the dispatched success handlers and number of them that did not
+  // finish yet, get() and take() wait for them
+  std::shared_ptr<shards_type> m_shards;
+  size_t m_running_shards{ 0 };
+
+  bool should_fan_out() const
+  {
+    return m_pool && m_post_on_pool && (m_fan_out_threshold > 0) &&
+      (m_success_handlers.size() > m_fan_out_threshold);
+  }
+
+  // Posts a pool task per shard of success handlers but the first one, which
+  // is run by the calling thread (with all the shards that could not be
+  // posted). The shards are set up under the mutex held by `lock`, then all
+  // the handlers run without it: they only read the result, which take() does
+  // not move before they are done.
+  void fan_out(std::unique_lock<std::mutex>& lock)
+  {
+    // the handlers are moved out so that a concurrent then() can not
+    // reallocate them while the shards are running
+    auto shards = std::make_shared<shards_type>(std::move(m_success_handlers), m_fan_out_shard_size);
+    m_success_handlers.clear();
+
+    m_shards         = shards;
+    m_running_shards = shards->get_count();
+
+    size_t posted = 0;
+    for(; posted + 1 < shards->get_count(); ++posted)
+    {
+      try
+      {
+        m_post_on_pool(m_pool,
+          [self = this->shared_from_this(), shards]
+          {
+            self->run_shards(*shards);
+          });
+      }
+      catch(...)
+      {
+        // e.g. the pool is stopped
+        break;
+      }
+    }
+
+    lock.unlock();
+
+    size_t ran = 0;
+    try
+    {
+      running_handlers_guard running(this);
+      shards->run(
+        [this](auto& cb)
+        {
+          std::invoke(cb, m_result);
+        },
+        ran,
+        shards->get_count() - posted);
+    }
+    catch(...)
+    {
+      lock.lock();
+      finish_inline_shards(ran);
+      throw;
+    }
+
+    lock.lock();
+    finish_inline_shards(ran);
+  }
+
+  // finish_shards for the shards run by fan_out, which holds m_mutex again
+  void finish_inline_shards(size_t count)
+  {
+    m_running_shards -= count;
+    if(m_running_shards == 0)
+    {
+      m_shards.reset();
+    }
+  }
+
+  // Runs the shards nobody claimed yet, on a pool task or a waiting thread
+  void run_shards(shards_type& shards)
+  {
+    size_t ran = 0;
+    try
+    {
+      running_handlers_guard running(this);
+      shards.run(
+        [this](auto& cb)
+        {
+          std::invoke(cb, m_result);
+        },
+        ran);
+    }
+    catch(...)
+    {
+      finish_shards(ran);
+      throw;
+    }
+
+    finish_shards(ran);
+  }
+
+  void finish_shards(size_t count)
+  {
+    if(count == 0)
+    {
+      return;
+    }
+
+    std::lock_guard lock(m_mutex);
+
+    m_running_shards -= count;
+    if(m_running_shards == 0)
+    {
+      m_shards.reset();
+      m_condition_variable.notify_all();
+    }
+  }
 
-  void on_ready()
+  // Helps running the dispatched success handlers and waits until they are
+  // all done. `lock` holds m_mutex. A handler of this state does not wait:
+  // its own shard only finishes once it returns.
+  void wait_for_shards(std::unique_lock<std::mutex>& lock)
+  {
+    if(m_running_shards == 0 || is_running_handlers())
+    {
+      return;
+    }
+
+    auto shards = m_shards;
+
+    lock.unlock();
+    run_shards(*shards);
+    lock.lock();
+
+    m_condition_variable.wait(lock,
+      [this]
+      {
+        return m_running_shards == 0;
+      });
+  }
+
+  // Whether the calling thread is running a success handler of this state
+  bool is_running_handlers() const
+  {
+    return g_running_handlers_of == this;
+  }
+
+  void on_ready(std::unique_lock<std::mutex>& lock)
   {
     assert(m_is_ready);
     if(m_exception)
@@ -89,6 +369,10 @@ class state
         }
       }
     }
+    else if(should_fan_out())
+    {
+      fan_out(lock);
+    }
     else
     {
       for(auto&& cb : m_success_handlers)
@@ -97,9 +381,19 @@ class state
       }
     }
 
+    release_handlers();
+
     m_condition_variable.notify_all();
   }
 
+  // The handlers only fire once. Releasing them breaks the ownership cycles of
+  // the continuations that keep their own future alive (e.g. plz::futures).
+  void release_handlers()
+  {
+    m_success_handlers.clear();
+    m_exceptions_handlers.clear();
+  }
+
   template <typename Func, typename... Args>
     requires std::same_as<std::invoke_result_t<Func, Args..., result_type>, void>
   void then_impl(Func&& func, Args&&... args)
@@ -123,8 +417,9 @@ class state
     using future_result_type =
       typename get_template_arg_type_of<func_return_type>::template arg<0>::type;
 
-    auto promise                   = make_promise<future_result_type>();
-    promise.m_shared_state->m_pool = m_pool;
+    auto promise                           = make_promise<future_result_type>();
+    promise.m_shared_state->m_pool         = m_pool;
+    promise.m_shared_state->m_post_on_pool = m_post_on_pool;
 
     std::lock_guard lock(m_mutex);
 
@@ -186,8 +481,9 @@ class state
 
     std::lock_guard lock(m_mutex);
 
-    auto promise                   = make_promise<func_return_type>();
-    promise.m_shared_state->m_pool = m_pool;
+    auto promise                           = make_promise<func_return_type>();
+    promise.m_shared_state->m_pool         = m_pool;
+    promise.m_shared_state->m_post_on_pool = m_post_on_pool;
 
     m_success_handlers.push_back(
       [func = std::forward<Func>(func), promise, ... args = std::forward<Args>(args)](
@@ -268,7 +564,7 @@ class state
 ////////////////////////////////////////////
 
 template <>
-class state<void>
+class state<void> : public std::enable_shared_from_this<state<void>>
 {
   template <typename X>
   friend class plz::future;
@@ -287,8 +583,164 @@ class state<void>
   std::vector<std::function<bool(const std::exception_ptr&)>> m_exceptions_handlers;
 
   thread_pool* m_pool{};
+  post_on_pool_function m_post_on_pool{};
+
+  using shards_type = handler_shards<std::function<void()>>;
+
+  // success handlers are dispatched on m_pool when there are more than
+  // m_fan_out_threshold of them (0 disables the parallel dispatch)
+  size_t m_fan_out_threshold{ 0 };
+  size_t m_fan_out_shard_size{ 1 };
+
+  // shards of the dispatched success handlers and number of them that did not
+  // finish yet, get() and take() wait for them
+  std::shared_ptr<shards_type> m_shards;
+  size_t m_running_shards{ 0 };
+
+  bool should_fan_out() const
+  {
+    return m_pool && m_post_on_pool && (m_fan_out_threshold > 0) &&
+      (m_success_handlers.size() > m_fan_out_threshold);
+  }
+
+  // Posts a pool task per shard of success handlers but the first one, which
+  // is run by the calling thread (with all the shards that could not be
+  // posted). The shards are set up under the mutex held by `lock`, then all
+  // the handlers run without it: they only read the result, which take() does
+  // not move before they are done.
+  void fan_out(std::unique_lock<std::mutex>& lock)
+  {
+    // the handlers are moved out so that a concurrent then() can not
+    // reallocate them while the shards are running
+    auto shards = std::make_shared<shards_type>(std::move(m_success_handlers), m_fan_out_shard_size);
+    m_success_handlers.clear();
+
+    m_shards         = shards;
+    m_running_shards = shards->get_count();
+
+    size_t posted = 0;
+    for(; posted + 1 < shards->get_count(); ++posted)
+    {
+      try
+      {
+        m_post_on_pool(m_pool,
+          [self = this->shared_from_this(), shards]
+          {
+            self->run_shards(*shards);
+          });
+      }
+      catch(...)
+      {
+        // e.g. the pool is stopped
+        break;
+      }
+    }
+
+    lock.unlock();
+
+    size_t ran = 0;
+    try
+    {
+      running_handlers_guard running(this);
+      shards->run(
+        [this](auto& cb)
+        {
+          std::invoke(cb);
+        },
+        ran,
+        shards->get_count() - posted);
+    }
+    catch(...)
+    {
+      lock.lock();
+      finish_inline_shards(ran);
+      throw;
+    }
 
-  void on_ready()
+    lock.lock();
+    finish_inline_shards(ran);
+  }
+
+  // finish_shards for the shards run by fan_out, which holds m_mutex again
+  void finish_inline_shards(size_t count)
+  {
+    m_running_shards -= count;
+    if(m_running_shards == 0)
+    {
+      m_shards.reset();
+    }
+  }
+
+  // Runs the shards nobody claimed yet, on a pool task or a waiting thread
+  void run_shards(shards_type& shards)
+  {
+    size_t ran = 0;
+    try
+    {
+      running_handlers_guard running(this);
+      shards.run(
+        [this](auto& cb)
+        {
+          std::invoke(cb);
+        },
+        ran);
+    }
+    catch(...)
+    {
+      finish_shards(ran);
+      throw;
+    }
+
+    finish_shards(ran);
+  }
+
+  void finish_shards(size_t count)
+  {
+    if(count == 0)
+    {
+      return;
+    }
+
+    std::lock_guard lock(m_mutex);
+
+    m_running_shards -= count;
+    if(m_running_shards == 0)
+    {
+      m_shards.reset();
+      m_condition_variable.notify_all();
+    }
+  }
+
+  // Helps running the dispatched success handlers and waits until they are
+  // all done. `lock` holds m_mutex. A handler of this state does not wait:
+  // its own shard only finishes once it returns.
+  void wait_for_shards(std::unique_lock<std::mutex>& lock)
+  {
+    if(m_running_shards == 0 || is_running_handlers())
+    {
+      return;
+    }
+
+    auto shards = m_shards;
+
+    lock.unlock();
+    run_shards(*shards);
+    lock.lock();
+
+    m_condition_variable.wait(lock,
+      [this]
+      {
+        return m_running_shards == 0;
+      });
+  }
+
+  // Whether the calling thread is running a success handler of this state
+  bool is_running_handlers() const
+  {
+    return g_running_handlers_of == this;
+  }
+
+  void on_ready(std::unique_lock<std::mutex>& lock)
   {
     assert(m_is_ready);
     if(m_exception)
@@ -302,6 +754,10 @@ class state<void>
         }
       }
     }
+    else if(should_fan_out())
+    {
+      fan_out(lock);
+    }
     else
     {
       for(auto&& cb : m_success_handlers)
@@ -310,9 +766,19 @@ class state<void>
       }
     }
 
+    release_handlers();
+
     m_condition_variable.notify_all();
   }
 
+  // The handlers only fire once. Releasing them breaks the ownership cycles of
+  // the continuations that keep their own future alive (e.g. plz::futures).
+  void release_handlers()
+  {
+    m_success_handlers.clear();
+    m_exceptions_handlers.clear();
+  }
+
   template <typename Func, typename... Args>
     requires std::same_as<std::invoke_result_t<Func, Args...>, void>
   void then_impl(Func&& func, Args&&... args)
@@ -335,8 +801,9 @@ class state<void>
     using future_result_type =
       typename get_template_arg_type_of<func_return_type>::template arg<0>::type;
 
-    auto promise                   = make_promise<future_result_type>();
-    promise.m_shared_state->m_pool = m_pool;
+    auto promise                           = make_promise<future_result_type>();
+    promise.m_shared_state->m_pool         = m_pool;
+    promise.m_shared_state->m_post_on_pool = m_post_on_pool;
 
     std::lock_guard lock(m_mutex);
 
@@ -397,8 +864,9 @@ class state<void>
 
     std::lock_guard lock(m_mutex);
 
-    auto promise                   = make_promise<func_return_type>();
-    promise.m_shared_state->m_pool = m_pool;
+    auto promise                           = make_promise<func_return_type>();
+    promise.m_shared_state->m_pool         = m_pool;
+    promise.m_shared_state->m_post_on_pool = m_post_on_pool;
 
     m_success_handlers.push_back(
       [func = std::forward<Func>(func), promise, ... args = std::forward<Args>(args)]() mutable
@@ -488,6 +956,7 @@ class future
   result_type get()
     requires(std::is_same_v<result_type, void> || std::is_copy_constructible_v<result_type>)
   {
+    detail::worker_wait_guard wait_guard;
     std::unique_lock lock(m_shared_state->m_mutex);
 
     m_shared_state->m_condition_variable.wait(lock,
@@ -496,6 +965,8 @@ class future
         return m_shared_state->m_is_ready;
       });
 
+    m_shared_state->wait_for_shards(lock);
+
     if(m_shared_state->m_exception)
     {
       std::rethrow_exception(m_shared_state->m_exception);
@@ -510,6 +981,7 @@ class future
   result_type take()
     requires(!(std::is_same_v<result_type, void>))
   {
+    detail::worker_wait_guard wait_guard;
     std::unique_lock lock(m_shared_state->m_mutex);
 
     m_shared_state->m_condition_variable.wait(lock,
@@ -518,6 +990,10 @@ class future
         return m_shared_state->m_is_ready;
       });
 
+    // the other handlers may still read the result
+    assert(!m_shared_state->is_running_handlers() && "take() from a success handler of the same future");
+    m_shared_state->wait_for_shards(lock);
+
     m_shared_state->m_is_ready = false;
 
     return std::move(m_shared_state->m_result);
@@ -557,6 +1033,30 @@ class future
     return *this;
   }
 
+  /**
+   * Dispatches the continuations in parallel on the thread pool of the future
+   * once more than `threshold` of them are attached. The continuations are
+   * split in shards of `shard_size` handlers, the thread that fulfills the
+   * promise runs the first shard and posts the others on the pool. The order in
+   * which the continuations run is then unspecified, get() and take() return
+   * once they all ran (a thread blocked in them runs the shards no worker
+   * started yet).
+   *
+   * Has no effect if the future is not bound to a thread pool.
+   *
+   * @param threshold number of continuations above which they are dispatched in parallel, 0 disables it.
+   * @param shard_size number of continuations run by each pool task.
+   */
+  auto& set_parallel_dispatch(size_t threshold, size_t shard_size = 16)
+  {
+    std::lock_guard lock(m_shared_state->m_mutex);
+
+    m_shared_state->m_fan_out_threshold  = threshold;
+    m_shared_state->m_fan_out_shard_size = std::max<size_t>(shard_size, 1);
+
+    return *this;
+  }
+
   private:
   friend class promise<result_type>;
 
@@ -601,7 +1101,7 @@ class promise
     requires std::convertible_to<U, result_type>
   void set_result(U&& result)
   {
-    std::lock_guard lock(m_shared_state->m_mutex);
+    std::unique_lock lock(m_shared_state->m_mutex);
 
     if(m_shared_state->m_is_ready)
     {
@@ -619,14 +1119,14 @@ class promise
 
     m_shared_state->m_is_ready = true;
 
-    m_shared_state->on_ready();
+    m_shared_state->on_ready(lock);
   }
 
   template <typename U = result_type>
     requires std::same_as<U, void>
   void set_ready()
   {
-    std::lock_guard lock(m_shared_state->m_mutex);
+    std::unique_lock lock(m_shared_state->m_mutex);
 
     if(m_shared_state->m_is_ready)
     {
@@ -635,7 +1135,7 @@ class promise
 
     m_shared_state->m_is_ready = true;
 
-    m_shared_state->on_ready();
+    m_shared_state->on_ready(lock);
   }
 
   template <typename ExcpetionType>
@@ -649,7 +1149,7 @@ class promise
   {
     assert(exception_ptr != nullptr);
 
-    std::lock_guard lock(m_shared_state->m_mutex);
+    std::unique_lock lock(m_shared_state->m_mutex);
     if(m_shared_state->m_is_ready)
     {
       throw std::runtime_error("promise is already ready");
@@ -658,7 +1158,7 @@ class promise
     m_shared_state->m_exception = exception_ptr;
     m_shared_state->m_is_ready  = true;
 
-    m_shared_state->on_ready();
+    m_shared_state->on_ready(lock);
   }
 
   private:
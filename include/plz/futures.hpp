@@ -60,11 +60,13 @@ class futures
   };
 
   private:
-  class state
+  class state : public std::enable_shared_from_this<state>
   {
     friend class futures<T, Key>;
 
-    promise<aggregate_result_type>* m_aggregate_promise;
+    // shares the shared state of futures::m_aggregate_promise, a pointer to it
+    // would dangle once the futures object is copied or moved
+    promise<aggregate_result_type> m_aggregate_promise;
     std::vector<future_element> m_futures;
     std::mutex m_mutex;
     size_t m_ready_count{ 0 };
@@ -75,53 +77,79 @@ class futures
       std::lock_guard guard{ m_mutex };
     }
 
-    state(futures_map_type futures, promise<aggregate_result_type>* aggregate_promise)
-      : m_aggregate_promise{ aggregate_promise }
+    state(promise<aggregate_result_type> aggregate_promise) : m_aggregate_promise{ aggregate_promise }
     {
-      size_t index{ 0 };
-      for(auto&& [key, future] : futures)
+    }
+
+    // Adds the futures, then registers their handlers once the state is owned
+    // by a shared_ptr, they hold a weak_ptr to it. The futures are all added
+    // first so that the handlers firing right away see the final count. The
+    // handlers are registered without the mutex: a completing future holds
+    // its own mutex while it calls them.
+    void add_futures(futures_map_type futures)
+    {
+      std::vector<std::pair<size_t, future<result_type>>> added;
       {
-        future
-          .then(
-            [this, index](const auto& res)
-            {
-              handle_future_ready(index, res);
-            })
-          .on_exception(
-            [this, index](const std::exception_ptr& exception)
-            {
-              handle_future_ready(index, exception);
-            });
+        std::lock_guard guard{ m_mutex };
 
-        m_futures.emplace_back(index++, std::move(key), std::move(future), std::monostate());
+        for(auto&& [key, future] : futures)
+        {
+          added.emplace_back(m_futures.size(), future);
+          m_futures.emplace_back(m_futures.size(), std::move(key), std::move(future), std::monostate());
+        }
+      }
+
+      for(auto& [index, future] : added)
+      {
+        add_handlers(index, future);
       }
     }
 
     void add_future(const key_type& key, future<result_type> future)
     {
-      std::lock_guard guard{ m_mutex };
-
-      if(m_futures.size() > 0 && m_ready_count == m_futures.size())
+      size_t index;
       {
-        throw std::runtime_error("All promises are already ready");
+        std::lock_guard guard{ m_mutex };
+
+        if(m_futures.size() > 0 && m_ready_count == m_futures.size())
+        {
+          throw std::runtime_error("All promises are already ready");
+        }
+
+        index = m_futures.size();
+        m_futures.emplace_back(index, key, future, std::monostate());
       }
 
+      add_handlers(index, future);
+    }
+
+    private:
+    // The handlers only hold a weak reference: a future may complete after
+    // the state was released, e.g. when the submission of the others threw
+    void add_handlers(size_t index, future<result_type>& future)
+    {
       future
         .then(
-          [this, index = m_futures.size()](const auto& res)
+          [weak_state = this->weak_from_this(), index](const auto& res)
           {
-            handle_future_ready(index, res);
+            if(auto self = weak_state.lock())
+            {
+              self->handle_future_ready(index, res);
+            }
           })
         .on_exception(
-          [this, index = m_futures.size()](const std::exception_ptr& exception)
+          [weak_state = this->weak_from_this(), index](const std::exception_ptr& exception)
           {
-            handle_future_ready(index, exception);
+            if(auto self = weak_state.lock())
+            {
+              self->handle_future_ready(index, exception);
+            }
           });
-
-      m_futures.emplace_back(m_futures.size(), key, std::move(future), std::monostate());
     }
 
-    private:
+    // The caller holds a reference: fulfilling the aggregate promise releases
+    // the continuation that keeps this state alive, it is destroyed after the
+    // mutex is unlocked
     void handle_future_ready(const size_t& index, result_variant result)
     {
       std::lock_guard guard{ m_mutex };
@@ -158,11 +186,11 @@ class futures
               return std::get<result_type>(element.result);
             });
 
-          m_aggregate_promise->set_result(accumulated_results);
+          m_aggregate_promise.set_result(accumulated_results);
         }
         else
         {
-          m_aggregate_promise->set_exception(
+          m_aggregate_promise.set_exception(
             std::get<std::exception_ptr>(has_exception_it->result));
         }
       }
@@ -173,27 +201,24 @@ class futures
   std::shared_ptr<state> m_state;
 
   public:
-  futures(const promises_map_type& promises_map)
-    : m_aggregate_promise{ make_promise<aggregate_result_type>() }
+  futures(const promises_map_type& promises_map) : futures(get_futures(promises_map))
   {
-    futures_map_type futures;
-    for(auto&& [key, promise] : promises_map)
-    {
-      futures.push_back({ key, promise.get_future() });
-    }
-
-    m_state = std::make_shared<state>(std::move(futures), &m_aggregate_promise);
   }
+
   futures(futures_map_type futures)
 
     : m_aggregate_promise{ make_promise<aggregate_result_type>() },
-      m_state{ std::make_shared<state>(std::move(futures), &m_aggregate_promise) }
+      m_state{ std::make_shared<state>(m_aggregate_promise) }
   {
-    // capture promises by a copy that share ownership in order to make sure m_promises lives at least until the aggregate promise is fulfilled
+    // capture promises by a copy that share ownership in order to make sure m_promises lives at least until the aggregate promise is fulfilled.
+    // The continuation is released once it fired, which breaks the cycle state -> aggregate promise -> continuation -> state.
+    // It is registered before the futures, which may all be ready already
     m_aggregate_promise.get_future().then(
       [impl = m_state](const auto&)
       {
       });
+
+    m_state->add_futures(std::move(futures));
   }
 
   futures() : futures(futures_map_type{})
@@ -338,6 +363,18 @@ class futures
   {
     return m_aggregate_promise.get_future();
   }
+
+  private:
+  static futures_map_type get_futures(const promises_map_type& promises_map)
+  {
+    futures_map_type futures;
+    for(auto&& [key, promise] : promises_map)
+    {
+      futures.push_back({ key, promise.get_future() });
+    }
+
+    return futures;
+  }
 };
 
 template <typename T, typename Key>
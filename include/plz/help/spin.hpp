@@ -0,0 +1,55 @@
+#ifndef SPIN_HPP
+#define SPIN_HPP
+
+#include <cstddef>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+namespace plz
+{
+
+// Hints the cpu that the thread is spin waiting (pause on x86, yield on arm)
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield");
+#endif
+}
+
+// Spin waits with cpu_relax for the first spins, then yields the thread so
+// that an oversubscribed machine still makes progress
+class spin_backoff
+{
+  public:
+  void pause()
+  {
+    if(m_spins < s_max_spins)
+    {
+      ++m_spins;
+      cpu_relax();
+    }
+    else
+    {
+      std::this_thread::yield();
+    }
+  }
+
+  void reset()
+  {
+    m_spins = 0;
+  }
+
+  private:
+  static constexpr size_t s_max_spins = 4096;
+
+  size_t m_spins{ 0 };
+};
+
+} // namespace plz
+
+#endif // SPIN_HPP
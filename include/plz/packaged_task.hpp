@@ -7,6 +7,7 @@
 #include <stop_token>
 #include <tuple>
 #include <type_traits>
+#include <utility>
 
 #include "plz/help/type_traits.hpp"
 
@@ -51,12 +52,12 @@ class packaged_task
     {
       if constexpr(std::is_same_v<function_return_type, void>)
       {
-        std::apply(m_func, m_arguments);
+        call();
         m_promise.set_ready();
       }
       else
       {
-        m_promise.set_result(std::apply(m_func, m_arguments));
+        m_promise.set_result(call());
       }
     }
     catch(...)
@@ -71,6 +72,16 @@ class packaged_task
   }
 
   private:
+  // A task runs once, the arguments given as rvalues are moved to the
+  // function, which makes move-only arguments work
+  function_return_type call()
+  {
+    return [this]<size_t... I>(std::index_sequence<I...>) -> function_return_type
+    {
+      return m_func(static_cast<Args&&>(std::get<I>(m_arguments))...);
+    }(std::index_sequence_for<Args...>{});
+  }
+
   function_type m_func;
   function_arguments m_arguments;
   promise<function_return_type> m_promise;
@@ -113,13 +124,12 @@ class packaged_task_st
     {
       if constexpr(std::is_same_v<function_return_type, void>)
       {
-        std::apply(m_func, std::tuple_cat(m_arguments, std::make_tuple(thread_stop_token)));
+        call(thread_stop_token);
         m_promise.set_ready();
       }
       else
       {
-        m_promise.set_result(m_func,
-          std::tuple_cat(m_arguments, std::make_tuple(thread_stop_token)));
+        m_promise.set_result(call(thread_stop_token));
       }
     }
     catch(...)
@@ -134,6 +144,15 @@ class packaged_task_st
   }
 
   private:
+  // see packaged_task::call
+  function_return_type call(std::stop_token thread_stop_token)
+  {
+    return [this, &thread_stop_token]<size_t... I>(std::index_sequence<I...>) -> function_return_type
+    {
+      return m_func(static_cast<Args&&>(std::get<I>(m_arguments))..., std::move(thread_stop_token));
+    }(std::index_sequence_for<Args...>{});
+  }
+
   function_type m_func;
   function_arguments m_arguments;
   promise<function_return_type> m_promise;
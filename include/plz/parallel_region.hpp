@@ -0,0 +1,340 @@
+#ifndef __PARALLEL_REGION_H__
+#define __PARALLEL_REGION_H__
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <utility>
+
+#include "plz/help/spin.hpp"
+
+#include "fork_join.hpp"
+#include "thread_pool.hpp"
+
+namespace plz
+{
+
+class team_context;
+
+template <typename Func>
+  requires std::invocable<Func&, team_context&>
+void parallel_region(thread_pool& pool, size_t team_size, Func&& func);
+
+namespace detail
+{
+
+// thrown in the members waiting at a barrier when another member failed
+struct team_aborted
+{
+};
+
+// State shared by the members of a parallel_region
+struct team_state
+{
+  // set in `joined` once the team is launched
+  static constexpr size_t s_launched = size_t(1) << (sizeof(size_t) * 8 - 1);
+
+  // how long the master waits for the next member to join
+  static constexpr std::chrono::milliseconds s_join_window{ 10 };
+
+  // fixed by launch, before `ready` is set
+  size_t size{ 1 };
+
+  // number of spawned members that joined the team, s_launched once launched
+  alignas(64) std::atomic<size_t> joined{ 0 };
+  std::atomic<bool> ready{ false };
+
+  // sense reversing barrier: the last member to arrive resets the count and
+  // flips the sense the others spin on
+  alignas(64) std::atomic<size_t> barrier_count{ 1 };
+  alignas(64) std::atomic<bool> barrier_sense{ false };
+
+  alignas(64) std::atomic<size_t> singles_claimed{ 0 };
+
+  std::atomic<bool> aborted{ false };
+  std::exception_ptr exception;
+
+  void abort(std::exception_ptr member_exception)
+  {
+    if(!aborted.exchange(true))
+    {
+      exception = std::move(member_exception);
+    }
+  }
+
+  // Called by a spawned member once it runs: returns its index in the team,
+  // or 0 if the team was launched without it
+  size_t join()
+  {
+    auto count = joined.load(std::memory_order_relaxed);
+    do
+    {
+      if(count & s_launched)
+      {
+        return 0;
+      }
+    } while(!joined.compare_exchange_weak(count, count + 1, std::memory_order_relaxed));
+
+    spin_backoff backoff;
+    while(!ready.load(std::memory_order_acquire))
+    {
+      backoff.pause();
+    }
+
+    return count + 1;
+  }
+
+  // Called by the master: waits for the `spawned` members to join for as long
+  // as they keep coming, then launches the team with the ones that did. The
+  // members only spin at the barriers with threads that are sure to come.
+  void launch(size_t spawned)
+  {
+    spin_backoff backoff;
+
+    auto count         = joined.load(std::memory_order_relaxed);
+    auto last_progress = std::chrono::steady_clock::now();
+
+    while(count < spawned)
+    {
+      backoff.pause();
+
+      auto now       = std::chrono::steady_clock::now();
+      auto new_count = joined.load(std::memory_order_relaxed);
+
+      if(new_count != count)
+      {
+        count         = new_count;
+        last_progress = now;
+      }
+      else if(now - last_progress > s_join_window)
+      {
+        break;
+      }
+    }
+
+    size = (joined.fetch_or(s_launched, std::memory_order_relaxed) & ~s_launched) + 1;
+    barrier_count.store(size, std::memory_order_relaxed);
+    ready.store(true, std::memory_order_release);
+  }
+};
+
+} // namespace detail
+
+/**
+ * Handle a member of a parallel_region gets to know its place in the team and
+ * synchronize with the other members.
+ */
+class team_context
+{
+  public:
+  size_t thread_index() const
+  {
+    return m_index;
+  }
+
+  size_t team_size() const
+  {
+    return m_state->size;
+  }
+
+  bool is_master() const
+  {
+    return m_index == 0;
+  }
+
+  /**
+   * Waits for all the members of the team. Spins, then yields, and never
+   * takes a lock.
+   */
+  void barrier()
+  {
+    auto& state   = *m_state;
+    m_local_sense = !m_local_sense;
+
+    if(state.barrier_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      state.barrier_count.store(state.size, std::memory_order_relaxed);
+      state.barrier_sense.store(m_local_sense, std::memory_order_release);
+      return;
+    }
+
+    spin_backoff backoff;
+    while(state.barrier_sense.load(std::memory_order_acquire) != m_local_sense)
+    {
+      if(state.aborted.load(std::memory_order_relaxed))
+      {
+        throw detail::team_aborted{};
+      }
+
+      backoff.pause();
+    }
+  }
+
+  /**
+   * Runs `func` on the master (member 0) only, without barrier.
+   */
+  template <typename Func>
+  void master(Func&& func)
+  {
+    if(is_master())
+    {
+      std::invoke(std::forward<Func>(func));
+    }
+  }
+
+  /**
+   * Runs `func` on the first member that reaches this point, then waits for
+   * the whole team. Every member must go through the same `single` calls in
+   * the same order.
+   */
+  template <typename Func>
+  void single(Func&& func)
+  {
+    auto expected = m_singles_seen++;
+
+    if(m_state->singles_claimed.compare_exchange_strong(expected, expected + 1))
+    {
+      std::invoke(std::forward<Func>(func));
+    }
+
+    barrier();
+  }
+
+  /**
+   * Static share of this member in [begin, end): the range split in team_size()
+   * contiguous chunks whose sizes differ by one at most.
+   */
+  std::pair<size_t, size_t> static_range(size_t begin, size_t end) const
+  {
+    auto size  = end - begin;
+    auto count = team_size();
+
+    return { begin + size * m_index / count, begin + size * (m_index + 1) / count };
+  }
+
+  /**
+   * Calls func(i) for every i of the static share of this member in
+   * [begin, end), then waits for the whole team.
+   */
+  template <typename Func>
+    requires std::invocable<Func&, size_t>
+  void for_static(size_t begin, size_t end, Func&& func)
+  {
+    auto [first, last] = static_range(begin, end);
+
+    for(auto i = first; i < last; ++i)
+    {
+      func(i);
+    }
+
+    barrier();
+  }
+
+  private:
+  template <typename Func>
+    requires std::invocable<Func&, team_context&>
+  friend void parallel_region(thread_pool& pool, size_t team_size, Func&& func);
+
+  team_context(detail::team_state* state, size_t index) : m_state{ state }, m_index{ index }
+  {
+  }
+
+  detail::team_state* m_state;
+  size_t m_index;
+  bool m_local_sense{ false };
+  size_t m_singles_seen{ 0 };
+};
+
+/**
+ * Runs func(team_context&) on a team of `team_size` threads at once: the
+ * calling thread (member 0) and team_size - 1 workers of `pool`, and returns
+ * when all of them are done. The team is launched once, the members then
+ * synchronize with team_context::barrier, which makes iterative kernels
+ * (stencils, solvers) much cheaper than a map() and a get() per step.
+ *
+ * The team size is clamped to the number of threads that can run at once.
+ * The team is only launched with the workers that are actually free: the
+ * calling thread waits for the spawned members to start for as long as they
+ * keep coming, and those that start later do not take part. On a busy pool the
+ * team is smaller (down to the calling thread alone), but the members never
+ * wait at a barrier for a worker busy with other work. If a member throws,
+ * the members waiting at a barrier are unwound and the exception is rethrown
+ * here.
+ *
+ * ```
+ * plz::parallel_region(pool, 8, [&](plz::team_context& team)
+ *   {
+ *     for(int step = 0; step < steps; ++step)
+ *     {
+ *       team.for_static(1, n - 1, [&](size_t i) { next[i] = (current[i - 1] + current[i + 1]) / 2; });
+ *       team.single([&] { std::swap(current, next); });
+ *     }
+ *   });
+ * ```
+ */
+template <typename Func>
+  requires std::invocable<Func&, team_context&>
+void parallel_region(thread_pool& pool, size_t team_size, Func&& func)
+{
+  auto available = pool.get_thread_count() + (pool.get_current_worker_index() ? 0 : 1);
+  team_size      = std::clamp<size_t>(team_size, 1, available);
+
+  detail::team_state state;
+
+  auto run_member = [&state, &func](size_t index)
+  {
+    team_context team(&state, index);
+
+    try
+    {
+      func(team);
+    }
+    catch(const detail::team_aborted&)
+    {
+    }
+    catch(...)
+    {
+      state.abort(std::current_exception());
+    }
+  };
+
+  {
+    fork_join scope(pool);
+
+    for(size_t i = 1; i < team_size; ++i)
+    {
+      scope.spawn(
+        [&state, &run_member]
+        {
+          if(auto index = state.join(); index != 0)
+          {
+            run_member(index);
+          }
+        });
+    }
+
+    state.launch(team_size - 1);
+
+    run_member(0);
+    scope.sync();
+  }
+
+  if(state.exception)
+  {
+    std::rethrow_exception(state.exception);
+  }
+}
+
+template <typename Func>
+  requires std::invocable<Func&, team_context&>
+void parallel_region(size_t team_size, Func&& func)
+{
+  parallel_region(thread_pool::global_instance(), team_size, std::forward<Func>(func));
+}
+
+} // namespace plz
+
+#endif // __PARALLEL_REGION_H__
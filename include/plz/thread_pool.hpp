@@ -1,14 +1,25 @@
 #ifndef __THREAD_POOL_H__
 #define __THREAD_POOL_H__
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <ctime>
+#include <deque>
 #include <functional>
+#include <limits>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include <ranges>
+#include <stdexcept>
 #include <stop_token>
+#include <string_view>
 #include <thread>
 #include <type_traits>
+#include <unordered_map>
 #include <variant>
 #include <vector>
 
@@ -21,6 +32,8 @@
 namespace plz
 {
 
+class fork_join;
+
 void set_threads_count(int num_threads);
 
 template <typename Func, typename... Args>
@@ -29,6 +42,11 @@ auto run(Func&& function, Args&&... args);
 template <std::ranges::range Range, typename Func, typename... Args>
 auto map(Range&& range, Func&& function, Args&&... args);
 
+struct task_tag;
+
+template <std::ranges::range Range, typename Func, typename... Args>
+auto map(task_tag tag, Range&& range, Func&& function, Args&&... args);
+
 void wait();
 
 template <class Rep, class Period>
@@ -36,6 +54,232 @@ void wait_for(const std::chrono::duration<Rep, Period>& timeout);
 
 void quit();
 
+/**
+ * Lightweight label attached to the tasks submitted with the tagged overloads of
+ * thread_pool::run and thread_pool::map. The pool accumulates per tag
+ * statistics (see thread_pool::get_tag_stats). The name is not copied, it
+ * should refer to a string that outlives the pool, e.g. a string literal.
+ */
+struct task_tag
+{
+  constexpr task_tag() = default;
+
+  constexpr task_tag(const char* tag_name) : name{ tag_name }
+  {
+  }
+
+  constexpr explicit task_tag(std::string_view tag_name) : name{ tag_name }
+  {
+  }
+
+  constexpr bool empty() const
+  {
+    return name.empty();
+  }
+
+  std::string_view name;
+};
+
+/**
+ * Deadline of a task submitted with thread_pool::run(deadline, ...). Tasks with
+ * a deadline are run earliest deadline first, before the tasks without one
+ * that did not wait longer than thread_pool::set_deadline_slack.
+ */
+struct deadline
+{
+  deadline(std::chrono::steady_clock::time_point deadline_time) : time{ deadline_time }
+  {
+  }
+
+  // relative to now
+  template <class Rep, class Period>
+  deadline(const std::chrono::duration<Rep, Period>& timeout)
+    : time{ std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout) }
+  {
+  }
+
+  std::chrono::steady_clock::time_point time;
+};
+
+/**
+ * Exception the future of a task gets when the task is dequeued after its
+ * deadline: the task is dropped instead of run.
+ */
+class deadline_exceeded : public std::runtime_error
+{
+  public:
+  deadline_exceeded() : std::runtime_error("task deadline exceeded")
+  {
+  }
+};
+
+/**
+ * Memory a task submitted with thread_pool::run(memory_cost, ...) or
+ * thread_pool::map(memory_cost, ...) needs while it runs, see
+ * thread_pool::set_memory_budget.
+ */
+struct memory_cost
+{
+  size_t bytes;
+};
+
+struct task_tag_stats
+{
+  size_t count{ 0 };
+  std::chrono::nanoseconds queue_wait{ 0 };
+  std::chrono::nanoseconds wall_time{ 0 };
+  std::chrono::nanoseconds cpu_time{ 0 }; // thread cpu time, 0 where CLOCK_THREAD_CPUTIME_ID is not available
+
+  task_tag_stats& operator+=(const task_tag_stats& other)
+  {
+    count += other.count;
+    queue_wait += other.queue_wait;
+    wall_time += other.wall_time;
+    cpu_time += other.cpu_time;
+    return *this;
+  }
+};
+
+/**
+ * Event reported by the thread_pool watchdog.
+ */
+struct watchdog_event
+{
+  enum class kind
+  {
+    long_task,      // a worker has been running the same task for too long
+    blocked_in_get, // a worker has been blocked in future::get()/take() for too long
+    queue_stall     // the oldest queued task has been waiting for too long
+  };
+
+  static constexpr size_t no_worker = static_cast<size_t>(-1);
+
+  kind type;
+  size_t worker_index; // no_worker for queue_stall events
+  std::chrono::nanoseconds duration;
+};
+
+struct watchdog_options
+{
+  std::chrono::nanoseconds long_task_threshold{ std::chrono::milliseconds(100) };
+  std::chrono::nanoseconds blocked_in_get_threshold{ std::chrono::milliseconds(100) };
+  std::chrono::nanoseconds queue_age_threshold{ std::chrono::milliseconds(100) };
+  std::chrono::nanoseconds poll_interval{ std::chrono::milliseconds(10) };
+};
+
+namespace detail
+{
+
+inline int64_t steady_now()
+{
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+inline std::chrono::nanoseconds thread_cpu_time()
+{
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+  timespec time{};
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+  return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+#else
+  return std::chrono::nanoseconds(0);
+#endif
+}
+
+// Child task of a fork_join scope. It is allocated by its scope, never by the
+// pool, and queued on the worker local queues instead of the global one.
+struct fork_task
+{
+  // runs the child and signals its scope
+  void (*execute)(fork_task*);
+};
+
+// Pool and index of the worker running on this thread, if any
+struct current_worker
+{
+  thread_pool* pool{ nullptr };
+  size_t index{ 0 };
+};
+
+inline thread_local current_worker g_current_worker;
+
+// Bookkeeping of one thread_pool worker. Each worker gets its own cache line so
+// that the per task stores do not bounce between cores.
+struct alignas(64) worker_state
+{
+  // steady clock time at which the last task started while the watchdog was
+  // enabled, 0 once the worker went to sleep
+  std::atomic<int64_t> task_start{ 0 };
+
+  // steady clock time at which the worker blocked in future::get(), 0 otherwise
+  std::atomic<int64_t> wait_start{ 0 };
+
+  // statistics of the tagged tasks run by this worker, merged on read
+  std::mutex tag_stats_mutex;
+  std::unordered_map<std::string_view, task_tag_stats> tag_stats;
+
+  // fork_join children spawned on this worker. The owner pushes and pops at
+  // the back, idle workers steal from the front.
+  std::mutex fork_tasks_mutex;
+  std::deque<fork_task*> fork_tasks;
+
+  // the worker sleeps on its own condition, so that a task pinned on it wakes
+  // it and only it. Both are guarded by the pool mutex.
+  std::condition_variable wake_condition;
+  bool idle{ false };
+};
+
+} // namespace detail
+
+/**
+ * Interface of the hooks a thread_pool calls around the life of its tasks, to
+ * plug profilers, per task allocator scopes or request context propagation in
+ * the pool without wrapping every submitted callable.
+ *
+ * The hooks are registered when the pool is constructed. They are a runtime
+ * interface rather than a template parameter of thread_pool, which would make
+ * every pool, future and algorithm taking one a template: unused hooks do not
+ * compile out, a pool constructed without hooks pays a predictable null
+ * pointer check per call site, and one with hooks a virtual call.
+ */
+class scheduler_hooks
+{
+  public:
+  virtual ~scheduler_hooks() = default;
+
+  // Called on the submitting thread, with the pool mutex held (it must not use
+  // the pool), for every task the pool accepted. The returned value is passed
+  // back to on_task_begin/on_task_end, or to on_task_cancel, of that task.
+  virtual void* on_enqueue()
+  {
+    return nullptr;
+  }
+
+  // Called on the worker right before/after running a task. fork_join
+  // children get them too, with a null context: they do not go through
+  // on_enqueue, which would take the pool mutex on every spawn. A child run by
+  // fork_join::sync is nested in the calls of the task that waits.
+  virtual void on_task_begin([[maybe_unused]] size_t worker_index, [[maybe_unused]] void* context)
+  {
+  }
+
+  virtual void on_task_end([[maybe_unused]] size_t worker_index, [[maybe_unused]] void* context)
+  {
+  }
+
+  // Called instead of on_task_begin/on_task_end for a task that will never
+  // run because it was still queued when the pool quit.
+  virtual void on_task_cancel([[maybe_unused]] void* context)
+  {
+  }
+
+  // Called on a worker that finds no task to run, before it goes to sleep.
+  virtual void on_idle([[maybe_unused]] size_t worker_index)
+  {
+  }
+};
+
 class thread_pool
 {
   public:
@@ -43,6 +287,10 @@ class thread_pool
   using task_type    = plz::callable<void()>;
   using task_variant = std::variant<task_type, task_type_st>;
 
+  using watchdog_callback = std::function<void(const watchdog_event&)>;
+
+  using expire_function = plz::callable<void(std::exception_ptr)>;
+
   public:
   static void set_global_instance_thread_count(int num_threads)
   {
@@ -61,11 +309,21 @@ class thread_pool
     return instance;
   }
 
-  thread_pool(size_t num_threads = std::thread::hardware_concurrency())
+  thread_pool(size_t num_threads                = std::thread::hardware_concurrency(),
+    std::shared_ptr<scheduler_hooks> hooks = nullptr)
+    : m_hooks{ std::move(hooks) }
   {
     for(size_t i = 0; i < num_threads; ++i)
     {
-      m_threads.emplace_back(std::bind_front(&thread_pool::thread_work, this));
+      m_workers.push_back(std::make_unique<detail::worker_state>());
+    }
+
+    m_pinned_tasks.resize(num_threads);
+    m_pinned_tasks_dequeued.resize(num_threads);
+
+    for(size_t i = 0; i < num_threads; ++i)
+    {
+      m_threads.emplace_back(std::bind_front(&thread_pool::thread_work, this, i));
     }
   }
 
@@ -76,47 +334,68 @@ class thread_pool
 
   void run(task_variant&& task)
   {
+    run(task_tag{}, std::move(task));
+  }
+
+  void run(task_tag tag, task_variant&& task)
+  {
+    auto queued = make_queued_task(std::move(task), tag);
+
+    std::condition_variable* wake;
     {
       std::lock_guard lock(m_mutex);
 
-      if(m_stop)
-      {
-        throw std::runtime_error("enqueue on stopped thread_pool");
-      }
-
-      m_tasks.push(std::move(task));
+      admit(queued);
+      m_tasks.push(std::move(queued));
+      wake = take_idle_worker();
     }
 
-    m_workers_wait_condition.notify_one();
+    notify(wake);
   }
 
   template <typename Func, typename... Args>
     requires std::invocable<Func, Args...>
   auto run(Func&& function, Args&&... args) -> future<std::invoke_result_t<Func, Args...>>
+  {
+    return run(task_tag{}, std::forward<Func>(function), std::forward<Args>(args)...);
+  }
+
+  template <typename Func, typename... Args>
+    requires std::invocable<Func, Args..., std::stop_token>
+  auto run(Func&& function,
+    Args&&... args) -> future<std::invoke_result_t<Func, Args..., std::stop_token>>
+  {
+    return run(task_tag{}, std::forward<Func>(function), std::forward<Args>(args)...);
+  }
+
+  template <typename Func, typename... Args>
+    requires std::invocable<Func, Args...>
+  auto run(task_tag tag, Func&& function, Args&&... args)
+    -> future<std::invoke_result_t<Func, Args...>>
   {
     packaged_task<Func, Args...> task{ std::forward<Func>(function),
       std::forward<Args>(args)... };
 
-    auto future                           = task.get_future();
-    task.m_promise.m_shared_state->m_pool = this;
+    auto future = task.get_future();
+    bind_promise(task.m_promise);
 
-    run(task_variant(task_type::from(std::move(task))));
+    run(tag, task_variant(task_type::from(std::move(task))));
 
     return future;
   }
 
   template <typename Func, typename... Args>
     requires std::invocable<Func, Args..., std::stop_token>
-  auto run(Func&& function,
-    Args&&... args) -> future<std::invoke_result_t<Func, Args..., std::stop_token>>
+  auto run(task_tag tag, Func&& function, Args&&... args)
+    -> future<std::invoke_result_t<Func, Args..., std::stop_token>>
   {
     packaged_task_st<Func, Args...> task{ std::forward<Func>(function),
       std::forward<Args>(args)... };
 
-    auto future                           = task.get_future();
-    task.m_promise.m_shared_state->m_pool = this;
+    auto future = task.get_future();
+    bind_promise(task.m_promise);
 
-    run(task_variant(task_type_st(std::move(task))));
+    run(tag, task_variant(task_type_st(std::move(task))));
 
     return future;
   }
@@ -126,48 +405,10 @@ class thread_pool
   auto map(Range&& range, Func&& function, Args&&... args)
     -> futures<std::invoke_result_t<Func, std::ranges::range_value_t<Range>, Args...>, std::ranges::range_value_t<Range>>
   {
-    using KeyType = std::ranges::range_value_t<Range>;
-
-    using func_return_type =
-      typename std::invoke_result_t<Func, std::ranges::range_value_t<Range>, Args...>;
-
-    using FuturesMapType = typename futures<func_return_type, KeyType>::futures_map_type;
-
-    std::lock_guard lock(m_mutex);
-    FuturesMapType futuresMap;
-
-    if(!m_stop)
-    {
-      for(auto&& v : range)
-      {
-        packaged_task task{ std::forward<Func>(function),
-          std::forward<KeyType>(v),
-          std::forward<Args>(args)... };
-
-        auto future                           = task.get_future();
-        task.m_promise.m_shared_state->m_pool = this;
-
-        m_tasks.emplace(task_type::from(std::move(task)));
-
-        futuresMap.push_back({ v, std::move(future) });
-      }
-
-      futures<func_return_type, KeyType> futures(std::move(futuresMap));
-      futures.m_aggregate_promise.m_shared_state->m_pool = this;
-
-      auto size = std::ranges::size(range);
-
-      for(auto i = 0; i < size; ++i)
-      {
-        m_workers_wait_condition.notify_one();
-      }
-
-      return futures;
-    }
-    else
-    {
-      throw std::runtime_error("enqueue on stopped thread_pool");
-    }
+    return map(task_tag{},
+      std::forward<Range>(range),
+      std::forward<Func>(function),
+      std::forward<Args>(args)...);
   }
 
   template <std::ranges::range Range, typename Func, typename... Args>
@@ -176,162 +417,1414 @@ class thread_pool
     -> futures<std::invoke_result_t<Func, std::ranges::range_value_t<Range>, Args..., std::stop_token>,
       std::ranges::range_value_t<Range>>
   {
-    using KeyType = std::ranges::range_value_t<Range>;
-
-    using func_return_type =
-      typename std::invoke_result_t<Func, std::ranges::range_value_t<Range>, Args..., std::stop_token>;
-
-    using FuturesMapType = typename futures<func_return_type, KeyType>::futures_map_type;
+    return map(task_tag{},
+      std::forward<Range>(range),
+      std::forward<Func>(function),
+      std::forward<Args>(args)...);
+  }
 
-    std::lock_guard lock(m_mutex);
-    FuturesMapType futuresMap;
+  template <std::ranges::range Range, typename Func, typename... Args>
+    requires std::invocable<Func, std::ranges::range_value_t<Range>, Args...>
+  auto map(task_tag tag, Range&& range, Func&& function, Args&&... args)
+    -> futures<std::invoke_result_t<Func, std::ranges::range_value_t<Range>, Args...>, std::ranges::range_value_t<Range>>
+  {
+    return map_impl(tag,
+      std::nullopt,
+      std::forward<Range>(range),
+      std::forward<Func>(function),
+      std::forward<Args>(args)...);
+  }
 
-    if(!m_stop)
-    {
-      for(auto&& v : range)
-      {
-        packaged_task_st task{ std::forward<Func>(function),
-          std::forward<KeyType>(v),
-          std::forward<Args>(args)... };
+  template <std::ranges::range Range, typename Func, typename... Args>
+    requires std::invocable<Func, std::ranges::range_value_t<Range>, Args..., std::stop_token>
+  auto map(task_tag tag, Range&& range, Func&& function, Args&&... args)
+    -> futures<std::invoke_result_t<Func, std::ranges::range_value_t<Range>, Args..., std::stop_token>,
+      std::ranges::range_value_t<Range>>
+  {
+    return map_impl(tag,
+      std::nullopt,
+      std::forward<Range>(range),
+      std::forward<Func>(function),
+      std::forward<Args>(args)...);
+  }
 
-        auto future                           = task.get_future();
-        task.m_promise.m_shared_state->m_pool = this;
+  /**
+   * Submits the callables in [first, last) (each one is copied) as a batch:
+   * they are queued with a single lock of the pool and only min(count, idle
+   * workers) workers are woken up. Returns the futures of the callables, in
+   * order.
+   */
+  template <std::input_iterator Iterator, std::sentinel_for<Iterator> Sentinel>
+    requires std::invocable<std::iter_reference_t<Iterator>>
+  auto submit_bulk(Iterator first, Sentinel last)
+    -> std::vector<future<std::invoke_result_t<std::iter_value_t<Iterator>&>>>
+  {
+    using func_type = std::iter_value_t<Iterator>;
 
-        m_tasks.emplace(task_type_st::from(std::move(task)));
+    std::vector<future<std::invoke_result_t<func_type&>>> futures;
+    std::vector<queued_task> tasks;
 
-        futuresMap.push_back({ v, std::move(future) });
-      }
+    for(; first != last; ++first)
+    {
+      packaged_task<func_type> task{ func_type(*first) };
 
-      futures<func_return_type, KeyType> futures(std::move(futuresMap));
-      futures.m_aggregate_promise.m_shared_state->m_pool = this;
+      futures.push_back(task.get_future());
+      bind_promise(task.m_promise);
 
-      auto size = std::ranges::size(range);
+      tasks.push_back(make_queued_task(task_type::from(std::move(task))));
+    }
 
-      for(auto i = 0; i < size; ++i)
-      {
-        m_workers_wait_condition.notify_one();
-      }
+    enqueue_batch(m_tasks, tasks);
 
-      return futures;
-    }
-    else
-    {
-      throw std::runtime_error("enqueue on stopped thread_pool");
-    }
+    return futures;
   }
 
-  void wait()
+  /**
+   * submit_bulk over a range of callables, e.g. a std::span.
+   */
+  template <std::ranges::input_range Range>
+    requires std::invocable<std::ranges::range_reference_t<Range>>
+  auto run_batch(Range&& callables)
   {
-    std::unique_lock lock{ m_mutex };
+    return submit_bulk(std::ranges::begin(callables), std::ranges::end(callables));
+  }
 
-    while(!is_idle())
+  /**
+   * Sets the memory budget of the tasks submitted with a memory_cost: such a
+   * task is only started while the costs of the ones running, its own
+   * included, stay within the budget (or when none is running), the others
+   * wait in their own queue. That queue and the one of run() are served in
+   * submission order. This bounds memory concurrency independently of the
+   * number of threads. The budget is unlimited by default.
+   */
+  void set_memory_budget(size_t bytes)
+  {
     {
-      m_pool_wait_condition.wait(lock,
-        [this]()
-        {
-          return is_idle();
-        });
+      std::lock_guard lock(m_mutex);
+      m_memory_budget = bytes;
     }
+
+    wake_all_workers();
   }
 
-  template <class Rep, class Period>
-  void wait_for(const std::chrono::duration<Rep, Period>& timeout)
+  /**
+   * Sets how long a task without deadline may wait behind the tasks with one:
+   * it is ordered among them as if its deadline was its enqueue time plus
+   * `slack`, so that a steady stream of deadline tasks cannot starve it.
+   * 100ms by default.
+   */
+  void set_deadline_slack(std::chrono::nanoseconds slack)
   {
-    std::unique_lock lock{ m_mutex };
-
-    while(!is_idle())
-    {
-      m_pool_wait_condition.wait_for(lock,
-        timeout,
-        [this]()
-        {
-          return is_idle();
-        });
-    }
+    std::lock_guard lock(m_mutex);
+    m_deadline_slack = slack;
   }
 
-  void quit()
+  // sum of the memory costs of the tasks currently running
+  size_t get_memory_in_use() const
   {
-    {
-      std::lock_guard lock(m_mutex);
+    std::lock_guard lock(m_mutex);
+    return m_memory_in_use;
+  }
 
-      if(m_stop)
-      {
-        return;
-      }
+  template <typename Func, typename... Args>
+    requires std::invocable<Func, Args...>
+  auto run(memory_cost cost, Func&& function, Args&&... args)
+    -> future<std::invoke_result_t<Func, Args...>>
+  {
+    packaged_task<Func, Args...> task{ std::forward<Func>(function),
+      std::forward<Args>(args)... };
 
-      m_stop = true;
-    }
+    auto future = task.get_future();
+    bind_promise(task.m_promise);
 
-    m_workers_wait_condition.notify_all();
+    run(cost, task_variant(task_type::from(std::move(task))));
 
-    for(auto& th : m_threads)
-    {
-      th.request_stop();
-      th.join();
-    }
+    return future;
   }
 
-  private:
-  void thread_work(std::stop_token stop_token)
+  template <typename Func, typename... Args>
+    requires std::invocable<Func, Args..., std::stop_token>
+  auto run(memory_cost cost, Func&& function, Args&&... args)
+    -> future<std::invoke_result_t<Func, Args..., std::stop_token>>
   {
-    while(!m_stop)
-    {
-      task_variant task;
-      {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        m_workers_wait_condition.wait(lock,
-          [this]
-          {
-            return m_stop || !m_tasks.empty();
-          });
+    packaged_task_st<Func, Args...> task{ std::forward<Func>(function),
+      std::forward<Args>(args)... };
 
-        if(m_stop && m_tasks.empty())
-        {
-          return;
-        }
+    auto future = task.get_future();
+    bind_promise(task.m_promise);
 
-        task = std::move(m_tasks.front());
-        m_tasks.pop();
-      }
+    run(cost, task_variant(task_type_st(std::move(task))));
 
-      ++m_busy_count;
+    return future;
+  }
 
-      if(std::holds_alternative<task_type>(task))
-      {
-        std::get<task_type>(task)();
-      }
-      else
-      {
-        std::get<task_type_st>(task)(stop_token);
-      }
+  void run(memory_cost cost, task_variant&& task)
+  {
+    auto queued        = make_queued_task(std::move(task));
+    queued.memory_cost = cost.bytes;
 
-      --m_busy_count;
+    std::condition_variable* wake;
+    {
+      std::lock_guard lock(m_mutex);
 
-      if(m_busy_count == 0)
-      {
-        m_pool_wait_condition.notify_all();
-      }
+      admit(queued);
+      m_budget_tasks.push(std::move(queued));
+      wake = take_idle_worker();
     }
-  }
 
-  bool is_idle() const
-  {
-    return m_tasks.empty() && (m_busy_count == 0);
+    notify(wake);
   }
 
-  std::vector<std::jthread> m_threads;
-  std::queue<task_variant> m_tasks;
+  // every element costs `cost`, see set_memory_budget
+  template <std::ranges::range Range, typename Func, typename... Args>
+    requires std::invocable<Func, std::ranges::range_value_t<Range>, Args...>
+  auto map(memory_cost cost, Range&& range, Func&& function, Args&&... args)
+    -> futures<std::invoke_result_t<Func, std::ranges::range_value_t<Range>, Args...>, std::ranges::range_value_t<Range>>
+  {
+    return map_impl(task_tag{},
+      cost,
+      std::forward<Range>(range),
+      std::forward<Func>(function),
+      std::forward<Args>(args)...);
+  }
+
+  template <std::ranges::range Range, typename Func, typename... Args>
+    requires std::invocable<Func, std::ranges::range_value_t<Range>, Args..., std::stop_token>
+  auto map(memory_cost cost, Range&& range, Func&& function, Args&&... args)
+    -> futures<std::invoke_result_t<Func, std::ranges::range_value_t<Range>, Args..., std::stop_token>,
+      std::ranges::range_value_t<Range>>
+  {
+    return map_impl(task_tag{},
+      cost,
+      std::forward<Range>(range),
+      std::forward<Func>(function),
+      std::forward<Args>(args)...);
+  }
+
+  /**
+   * Runs the task before its deadline. The pool runs the tasks with a deadline
+   * earliest deadline first, ahead of the tasks without one until those waited
+   * for longer than the slack (see set_deadline_slack), and completes the
+   * future of a task still queued at its deadline with deadline_exceeded
+   * instead of running it, so that an overloaded pool sheds stale work rather
+   * than letting fresh requests time out behind it.
+   */
+  template <typename Func, typename... Args>
+    requires std::invocable<Func, Args...>
+  auto run(deadline task_deadline, Func&& function, Args&&... args)
+    -> future<std::invoke_result_t<Func, Args...>>
+  {
+    packaged_task<Func, Args...> task{ std::forward<Func>(function),
+      std::forward<Args>(args)... };
+
+    auto future = task.get_future();
+    bind_promise(task.m_promise);
+
+    auto expire = make_expire_function(task.m_promise);
+    run(task_deadline, task_variant(task_type::from(std::move(task))), std::move(expire));
+
+    return future;
+  }
+
+  template <typename Func, typename... Args>
+    requires std::invocable<Func, Args..., std::stop_token>
+  auto run(deadline task_deadline, Func&& function, Args&&... args)
+    -> future<std::invoke_result_t<Func, Args..., std::stop_token>>
+  {
+    packaged_task_st<Func, Args...> task{ std::forward<Func>(function),
+      std::forward<Args>(args)... };
+
+    auto future = task.get_future();
+    bind_promise(task.m_promise);
+
+    auto expire = make_expire_function(task.m_promise);
+    run(task_deadline, task_variant(task_type_st(std::move(task))), std::move(expire));
+
+    return future;
+  }
+
+  // `expire` is called instead of `task` when the deadline is exceeded
+  void run(deadline task_deadline, task_variant&& task, expire_function&& expire)
+  {
+    deadline_task queued{ make_queued_task(std::move(task)), task_deadline.time, std::move(expire) };
+
+    std::condition_variable* wake;
+    {
+      std::lock_guard lock(m_mutex);
+
+      admit(queued.queued);
+      queued.sequence = m_deadline_sequence++;
+      m_deadline_tasks.push_back(std::move(queued));
+      std::push_heap(m_deadline_tasks.begin(), m_deadline_tasks.end(), deadline_task::later);
+      wake = take_idle_worker();
+    }
+
+    notify(wake);
+  }
+
+  /**
+   * Runs the task on the worker `worker_index` (in [0, get_thread_count())),
+   * e.g. to keep the tasks touching the same data on the same core and its
+   * warm cache. Pinned tasks are never stolen by other workers and a worker
+   * runs its pinned tasks before the shared ones.
+   */
+  template <typename Func, typename... Args>
+    requires std::invocable<Func, Args...>
+  auto run_on(size_t worker_index, Func&& function, Args&&... args)
+    -> future<std::invoke_result_t<Func, Args...>>
+  {
+    packaged_task<Func, Args...> task{ std::forward<Func>(function),
+      std::forward<Args>(args)... };
+
+    auto future = task.get_future();
+    bind_promise(task.m_promise);
+
+    run_on(worker_index, task_variant(task_type::from(std::move(task))));
+
+    return future;
+  }
+
+  template <typename Func, typename... Args>
+    requires std::invocable<Func, Args..., std::stop_token>
+  auto run_on(size_t worker_index, Func&& function, Args&&... args)
+    -> future<std::invoke_result_t<Func, Args..., std::stop_token>>
+  {
+    packaged_task_st<Func, Args...> task{ std::forward<Func>(function),
+      std::forward<Args>(args)... };
+
+    auto future = task.get_future();
+    bind_promise(task.m_promise);
+
+    run_on(worker_index, task_variant(task_type_st(std::move(task))));
+
+    return future;
+  }
+
+  void run_on(size_t worker_index, task_variant&& task)
+  {
+    if(worker_index >= m_pinned_tasks.size())
+    {
+      throw std::out_of_range("run_on: invalid worker index");
+    }
+
+    auto queued = make_queued_task(std::move(task));
+
+    std::condition_variable* wake;
+    {
+      std::lock_guard lock(m_mutex);
+
+      admit(queued);
+      m_pinned_tasks[worker_index].push(std::move(queued));
+      ++m_pinned_tasks_count;
+
+      // no other worker can run it, there is no point in waking them
+      wake = take_idle_worker(worker_index);
+    }
+
+    notify(wake);
+  }
+
+  /**
+   * Runs the task on the worker picked by hashing `key`, so that all the tasks
+   * submitted with the same key (e.g. a shard or partition id) run on the same
+   * worker. See run_on.
+   */
+  template <typename Key, typename Func, typename... Args>
+    requires std::invocable<std::hash<Key>, const Key&>
+  auto run_with_affinity(const Key& key, Func&& function, Args&&... args)
+  {
+    if(get_thread_count() == 0)
+    {
+      throw std::out_of_range("run_with_affinity: thread_pool has no worker");
+    }
+
+    return run_on(std::hash<Key>{}(key) % get_thread_count(),
+      std::forward<Func>(function),
+      std::forward<Args>(args)...);
+  }
+
+  void wait()
+  {
+    std::unique_lock lock{ m_mutex };
+
+    while(!is_idle())
+    {
+      m_pool_wait_condition.wait(lock,
+        [this]()
+        {
+          return is_idle();
+        });
+    }
+  }
+
+  template <class Rep, class Period>
+  void wait_for(const std::chrono::duration<Rep, Period>& timeout)
+  {
+    std::unique_lock lock{ m_mutex };
+
+    while(!is_idle())
+    {
+      m_pool_wait_condition.wait_for(lock,
+        timeout,
+        [this]()
+        {
+          return is_idle();
+        });
+    }
+  }
+
+  size_t get_thread_count() const
+  {
+    return m_threads.size();
+  }
+
+  /**
+   * Index in [0, get_thread_count()) of the calling worker, nullopt when the
+   * caller is not a worker of this pool.
+   */
+  std::optional<size_t> get_current_worker_index() const
+  {
+    auto& current = detail::g_current_worker;
+    if(current.pool != this)
+    {
+      return std::nullopt;
+    }
+
+    return current.index;
+  }
+
+  /**
+   * Returns the statistics of the tagged tasks that completed so far, merged
+   * from the per worker counters.
+   */
+  std::unordered_map<std::string_view, task_tag_stats> get_tag_stats() const
+  {
+    std::unordered_map<std::string_view, task_tag_stats> stats;
+
+    for(auto& worker : m_workers)
+    {
+      std::lock_guard lock(worker->tag_stats_mutex);
+      for(auto& [name, worker_stats] : worker->tag_stats)
+      {
+        stats[name] += worker_stats;
+      }
+    }
+
+    return stats;
+  }
+
+  void reset_tag_stats()
+  {
+    for(auto& worker : m_workers)
+    {
+      std::lock_guard lock(worker->tag_stats_mutex);
+      worker->tag_stats.clear();
+    }
+  }
+
+  /**
+   * Starts a watchdog thread that polls the workers every
+   * `options.poll_interval` and calls `callback` (on the watchdog thread) for
+   * tasks running longer than `options.long_task_threshold`, workers blocked
+   * in future::get() longer than `options.blocked_in_get_threshold` and a
+   * queue, shared, budgeted, with deadlines or pinned on a worker, that did
+   * not hand out a task for `options.queue_age_threshold`. Every task, wait
+   * or queue stall is reported at most once.
+   *
+   * While the watchdog is running, each task costs a clock read and a relaxed
+   * store of its start time, and each blocking get()/take() on a worker the
+   * stores of its start and end times. The queued tasks are not time stamped:
+   * the watchdog compares the number of tasks taken out of each queue between
+   * its polls, so the age of a stall is measured at the poll interval
+   * resolution. When it is not running, they only cost a relaxed load of the
+   * enabled flag.
+   */
+  void start_watchdog(watchdog_options options, watchdog_callback callback)
+  {
+    stop_watchdog();
+
+    // a worker that did not sleep since a previous watchdog still holds the
+    // start time of a task it finished, which must not be reported
+    std::vector<int64_t> reported_tasks;
+    for(auto& worker : m_workers)
+    {
+      reported_tasks.push_back(worker->task_start.load(std::memory_order_relaxed));
+    }
+
+    m_watchdog_enabled.store(true, std::memory_order_relaxed);
+    m_watchdog = std::jthread(std::bind_front(&thread_pool::watchdog_work, this),
+      options,
+      std::move(callback),
+      std::move(reported_tasks));
+  }
+
+  void stop_watchdog()
+  {
+    if(m_watchdog.joinable())
+    {
+      m_watchdog.request_stop();
+      m_watchdog.join();
+    }
+
+    m_watchdog_enabled.store(false, std::memory_order_relaxed);
+  }
+
+  void quit()
+  {
+    stop_watchdog();
+
+    {
+      std::lock_guard lock(m_mutex);
+
+      if(m_stop)
+      {
+        return;
+      }
+
+      m_stop = true;
+    }
+
+    wake_all_workers();
+
+    for(auto& th : m_threads)
+    {
+      th.request_stop();
+      th.join();
+    }
+
+    cancel_queued_tasks();
+  }
+
+  private:
+  friend class fork_join;
+
+  // Queues a fork_join child on the local queue of the calling worker, or on
+  // the local queue of a worker picked round robin when called from outside
+  // the pool. A worker only takes the pool mutex when another one is asleep.
+  //
+  // Workers drain the fork queues before they exit. A worker always gets to
+  // its own queue again, other threads push under the pool mutex so that the
+  // push either happens before the workers decide to exit or sees m_stop.
+  void push_fork_task(detail::fork_task* task)
+  {
+    auto& current = detail::g_current_worker;
+
+    if(current.pool == this)
+    {
+      push_local_fork_task(current.index, task);
+
+      // pairs with the increment of m_sleeping_count in set_idle: either the
+      // worker sees the new task before sleeping, or we see it asleep
+      if(m_sleeping_count.load() > 0)
+      {
+        std::condition_variable* wake;
+        {
+          std::lock_guard lock(m_mutex);
+          wake = take_idle_worker();
+        }
+
+        notify(wake);
+      }
+    }
+    else
+    {
+      std::condition_variable* wake;
+      {
+        std::lock_guard lock(m_mutex);
+
+        if(m_stop || m_workers.empty())
+        {
+          throw std::runtime_error("enqueue on stopped thread_pool");
+        }
+
+        push_local_fork_task(m_next_fork_worker++ % m_workers.size(), task);
+        wake = take_idle_worker();
+      }
+
+      notify(wake);
+    }
+  }
+
+  void push_local_fork_task(size_t index, detail::fork_task* task)
+  {
+    auto& worker = *m_workers[index];
+
+    std::lock_guard lock(worker.fork_tasks_mutex);
+    worker.fork_tasks.push_back(task);
+    m_fork_tasks_count.fetch_add(1);
+  }
+
+  // Pops the most recently spawned child of worker `index`
+  detail::fork_task* pop_local_fork_task(size_t index)
+  {
+    auto& worker = *m_workers[index];
+
+    std::lock_guard lock(worker.fork_tasks_mutex);
+    if(worker.fork_tasks.empty())
+    {
+      return nullptr;
+    }
+
+    auto task = worker.fork_tasks.back();
+    worker.fork_tasks.pop_back();
+    m_fork_tasks_count.fetch_sub(1);
+    return task;
+  }
+
+  // Pops the oldest child of another worker
+  detail::fork_task* steal_fork_task(size_t index)
+  {
+    for(size_t i = 1; i < m_workers.size() && m_fork_tasks_count.load() > 0; ++i)
+    {
+      auto& worker = *m_workers[(index + i) % m_workers.size()];
+
+      std::lock_guard lock(worker.fork_tasks_mutex);
+      if(!worker.fork_tasks.empty())
+      {
+        auto task = worker.fork_tasks.front();
+        worker.fork_tasks.pop_front();
+        m_fork_tasks_count.fetch_sub(1);
+        return task;
+      }
+    }
+
+    return nullptr;
+  }
+
+  // Runs a fork_join child on worker `index` between the task hooks, with
+  // its own start time for the watchdog. Children have no tag, they are left
+  // out of the tag statistics.
+  void execute_fork_task(size_t index, detail::fork_task* task)
+  {
+    auto& worker = *m_workers[index];
+
+    if(m_hooks)
+    {
+      m_hooks->on_task_begin(index, nullptr);
+    }
+
+    // the start time of the task that waits in fork_join::sync, if any
+    int64_t outer_start = 0;
+
+    bool watched = m_watchdog_enabled.load(std::memory_order_relaxed);
+    if(watched)
+    {
+      outer_start = worker.task_start.load(std::memory_order_relaxed);
+      worker.task_start.store(detail::steady_now(), std::memory_order_relaxed);
+    }
+
+    task->execute(task);
+
+    if(watched)
+    {
+      worker.task_start.store(outer_start, std::memory_order_relaxed);
+    }
+
+    if(m_hooks)
+    {
+      m_hooks->on_task_end(index, nullptr);
+    }
+  }
+
+  bool is_current_worker() const
+  {
+    return detail::g_current_worker.pool == this;
+  }
+
+  // Runs one child queued on the calling worker, or stolen from another one,
+  // used by fork_join::sync to help instead of blocking. Returns false if
+  // there was none, or if the caller is not a worker of this pool.
+  bool run_fork_task()
+  {
+    auto& current = detail::g_current_worker;
+    if(current.pool != this)
+    {
+      return false;
+    }
+
+    auto task = pop_local_fork_task(current.index);
+    if(task == nullptr && m_fork_tasks_count.load() > 0)
+    {
+      task = steal_fork_task(current.index);
+    }
+
+    if(task == nullptr)
+    {
+      return false;
+    }
+
+    execute_fork_task(current.index, task);
+    return true;
+  }
+
+  struct queued_task
+  {
+    task_variant task;
+    task_tag tag{};
+    std::chrono::steady_clock::time_point enqueue_time{};
+    void* hook_context{ nullptr };
+    size_t memory_cost{ 0 }; // see set_memory_budget
+    uint64_t sequence{ 0 };  // admission order, see budget_task_first
+  };
+
+  struct deadline_task
+  {
+    queued_task queued;
+    std::chrono::steady_clock::time_point deadline;
+    expire_function expire;
+    uint64_t sequence{ 0 }; // FIFO among equal deadlines
+
+    // heap order: the earliest deadline at the top
+    static bool later(const deadline_task& a, const deadline_task& b)
+    {
+      return a.deadline != b.deadline ? a.deadline > b.deadline : a.sequence > b.sequence;
+    }
+  };
+
+  // Argument of one of the tasks of map: lvalues are passed as is and copied
+  // by the task, rvalues are copied too since every task needs its own, only
+  // a move-only one is moved (to the only task, see map_impl)
+  template <typename Arg>
+  static decltype(auto) map_argument(std::remove_reference_t<Arg>& arg)
+  {
+    if constexpr(!std::is_lvalue_reference_v<Arg> && std::copy_constructible<Arg>)
+    {
+      return Arg(arg);
+    }
+    else
+    {
+      return static_cast<Arg&&>(arg);
+    }
+  }
+
+  // Tasks with a memory cost, even 0 like with run(memory_cost), go to the
+  // budget queue, the others to the shared one
+  template <std::ranges::range Range, typename Func, typename... Args>
+  auto map_impl(task_tag tag, std::optional<memory_cost> cost, Range&& range, Func&& function, Args&&... args)
+  {
+    using KeyType = std::ranges::range_value_t<Range>;
+
+    constexpr bool with_stop_token = std::invocable<Func, KeyType, Args..., std::stop_token>;
+
+    using func_return_type = typename std::conditional_t<with_stop_token,
+      std::invoke_result<Func, KeyType, Args..., std::stop_token>,
+      std::invoke_result<Func, KeyType, Args...>>::type;
+
+    using FuturesMapType = typename futures<func_return_type, KeyType>::futures_map_type;
+
+    constexpr bool copyable_arguments = (std::copy_constructible<std::decay_t<Args>> && ...);
+
+    FuturesMapType futuresMap;
+    std::vector<queued_task> tasks;
+
+    for(auto&& v : range)
+    {
+      if constexpr(!copyable_arguments)
+      {
+        if(!tasks.empty())
+        {
+          throw std::invalid_argument("map: a move-only argument can only be given to one task");
+        }
+      }
+
+      // the function is copied in every task, std::function requires it to be
+      // copyable anyway, see map_argument for the arguments
+      if constexpr(with_stop_token)
+      {
+        packaged_task_st<Func&, const KeyType&, Args...> task{ function,
+          v,
+          map_argument<Args>(args)... };
+
+        auto future = task.get_future();
+        bind_promise(task.m_promise);
+
+        tasks.push_back(make_queued_task(task_type_st::from(std::move(task)), tag));
+        futuresMap.push_back({ v, std::move(future) });
+      }
+      else
+      {
+        packaged_task<Func&, const KeyType&, Args...> task{ function,
+          v,
+          map_argument<Args>(args)... };
+
+        auto future = task.get_future();
+        bind_promise(task.m_promise);
+
+        tasks.push_back(make_queued_task(task_type::from(std::move(task)), tag));
+        futuresMap.push_back({ v, std::move(future) });
+      }
+
+      if(cost)
+      {
+        tasks.back().memory_cost = cost->bytes;
+      }
+    }
+
+    // the futures register their handlers before a worker can complete a task
+    futures<func_return_type, KeyType> futures(std::move(futuresMap));
+    bind_promise(futures.m_aggregate_promise);
+
+    try
+    {
+      enqueue_batch(cost ? m_budget_tasks : m_tasks, tasks);
+    }
+    catch(...)
+    {
+      // releases the continuation that keeps the futures state alive
+      futures.m_aggregate_promise.set_exception(std::current_exception());
+      throw;
+    }
+
+    return futures;
+  }
+
+  // Pushes the tasks under a single lock and wakes at most as many workers as
+  // there are tasks
+  void enqueue_batch(std::queue<queued_task>& queue, std::vector<queued_task>& tasks)
+  {
+    std::vector<std::condition_variable*> wake;
+    {
+      std::lock_guard lock(m_mutex);
+
+      for(auto& task : tasks)
+      {
+        admit(task);
+        queue.push(std::move(task));
+
+        if(auto condition = take_idle_worker())
+        {
+          wake.push_back(condition);
+        }
+      }
+    }
+
+    for(auto condition : wake)
+    {
+      notify(condition);
+    }
+  }
+
+  // Marks worker `index` as asleep or awake, m_mutex must be held
+  void set_idle(size_t index, bool idle)
+  {
+    auto& worker = *m_workers[index];
+    if(worker.idle == idle)
+    {
+      return;
+    }
+
+    worker.idle = idle;
+
+    if(idle)
+    {
+      m_idle_workers.push_back(index);
+      m_sleeping_count.fetch_add(1);
+    }
+    else
+    {
+      std::erase(m_idle_workers, index);
+      m_sleeping_count.fetch_sub(1);
+    }
+  }
+
+  // Takes an idle worker out of the idle list and returns the condition to
+  // notify once m_mutex is released, nullptr when every worker is awake: they
+  // all check the queues before going back to sleep. m_mutex must be held.
+  std::condition_variable* take_idle_worker()
+  {
+    if(m_idle_workers.empty())
+    {
+      return nullptr;
+    }
+
+    return take_idle_worker(m_idle_workers.back());
+  }
 
-  std::mutex m_mutex;
+  // Same for worker `index` only
+  std::condition_variable* take_idle_worker(size_t index)
+  {
+    auto& worker = *m_workers[index];
+    if(!worker.idle)
+    {
+      return nullptr;
+    }
+
+    set_idle(index, false);
+    return &worker.wake_condition;
+  }
+
+  static void notify(std::condition_variable* condition)
+  {
+    if(condition != nullptr)
+    {
+      condition->notify_one();
+    }
+  }
+
+  // wakes every worker to re-check its queues, e.g. on quit
+  void wake_all_workers()
+  {
+    for(auto& worker : m_workers)
+    {
+      worker->wake_condition.notify_one();
+    }
+  }
+
+  // whether the head of the budget queue can start, m_mutex must be held
+  bool can_admit_budget_task() const
+  {
+    if(m_budget_tasks.empty())
+    {
+      return false;
+    }
+
+    auto cost = m_budget_tasks.front().memory_cost;
+    return m_memory_in_use == 0 || cost <= m_memory_budget - std::min(m_memory_budget, m_memory_in_use);
+  }
+
+  // Whether the head of the budget queue goes before the head of the shared
+  // queue: it fits in the budget and was admitted first, so that a large
+  // budgeted map does not hold back the tasks queued with run() after it
+  // started. m_mutex must be held.
+  bool budget_task_first() const
+  {
+    return can_admit_budget_task() &&
+      (m_tasks.empty() || m_budget_tasks.front().sequence < m_tasks.front().sequence);
+  }
+
+  // Binds the future of `task_promise` to this pool, for async_then and for
+  // the parallel dispatch of its continuations
+  template <typename T>
+  void bind_promise(promise<T>& task_promise)
+  {
+    task_promise.m_shared_state->m_pool         = this;
+    task_promise.m_shared_state->m_post_on_pool = &post_on_pool;
+  }
+
+  static void post_on_pool(thread_pool* pool, const task_type& task)
+  {
+    pool->run(task_variant(task));
+  }
+
+  template <typename T>
+  static expire_function make_expire_function(promise<T> task_promise)
+  {
+    return expire_function(
+      [task_promise](std::exception_ptr exception) mutable
+      {
+        task_promise.set_exception(exception);
+      });
+  }
+
+  queued_task make_queued_task(task_variant&& task, task_tag tag = {}) const
+  {
+    queued_task queued{ .task = std::move(task), .tag = tag };
+
+    // for the queue time of the tag statistics
+    if(!tag.empty())
+    {
+      queued.enqueue_time = std::chrono::steady_clock::now();
+    }
+
+    return queued;
+  }
+
+  // Accepts `queued` in a queue of the pool, m_mutex must be held. The enqueue
+  // hook is only called for accepted tasks.
+  void admit(queued_task& queued)
+  {
+    if(m_stop)
+    {
+      throw std::runtime_error("enqueue on stopped thread_pool");
+    }
+
+    if(m_hooks)
+    {
+      queued.hook_context = m_hooks->on_enqueue();
+    }
+
+    queued.sequence = m_admit_sequence++;
+
+    // shared tasks compete with the deadline ones by age once the pool got
+    // one, see shared_task_first
+    if(m_deadline_sequence > 0 && queued.enqueue_time.time_since_epoch().count() == 0)
+    {
+      queued.enqueue_time = std::chrono::steady_clock::now();
+    }
+  }
+
+  // Whether the head of the shared queue goes before the earliest task with a
+  // deadline: it competes as if its deadline was its enqueue time plus the
+  // slack. A task without enqueue time was queued before any deadline task.
+  // m_mutex must be held.
+  bool shared_task_first() const
+  {
+    if(m_tasks.empty())
+    {
+      return false;
+    }
+
+    if(m_deadline_tasks.empty())
+    {
+      return true;
+    }
+
+    auto enqueue_time = m_tasks.front().enqueue_time;
+    return enqueue_time.time_since_epoch().count() == 0 ||
+      enqueue_time + m_deadline_slack <= m_deadline_tasks.front().deadline;
+  }
+
+  // Calls the cancel hook for the tasks left in the queues once the workers
+  // exited, and drops them
+  void cancel_queued_tasks()
+  {
+    std::queue<queued_task> tasks;
+    std::vector<std::queue<queued_task>> pinned_tasks;
+    std::vector<deadline_task> deadline_tasks;
+    std::queue<queued_task> budget_tasks;
+    {
+      std::lock_guard lock(m_mutex);
+
+      tasks.swap(m_tasks);
+      pinned_tasks.swap(m_pinned_tasks);
+      deadline_tasks.swap(m_deadline_tasks);
+      budget_tasks.swap(m_budget_tasks);
+
+      m_pinned_tasks.resize(pinned_tasks.size());
+      m_pinned_tasks_count = 0;
+    }
+
+    if(!m_hooks)
+    {
+      return;
+    }
+
+    auto cancel = [this](std::queue<queued_task>& queue)
+    {
+      for(; !queue.empty(); queue.pop())
+      {
+        m_hooks->on_task_cancel(queue.front().hook_context);
+      }
+    };
+
+    cancel(tasks);
+    cancel(budget_tasks);
+
+    for(auto& queue : pinned_tasks)
+    {
+      cancel(queue);
+    }
+
+    for(auto& task : deadline_tasks)
+    {
+      m_hooks->on_task_cancel(task.queued.hook_context);
+    }
+  }
+
+  void thread_work(size_t index, std::stop_token stop_token)
+  {
+    auto& worker = *m_workers[index];
+
+    detail::g_worker_wait    = { &worker.wait_start, &m_watchdog_enabled };
+    detail::g_current_worker    = { this, index };
+
+    while(true)
+    {
+      auto fork_task = pop_local_fork_task(index);
+      if(fork_task == nullptr && m_fork_tasks_count.load() > 0)
+      {
+        fork_task = steal_fork_task(index);
+      }
+
+      if(fork_task != nullptr)
+      {
+        ++m_busy_count;
+
+        execute_fork_task(index, fork_task);
+
+        if(--m_busy_count == 0)
+        {
+          m_pool_wait_condition.notify_all();
+        }
+
+        continue;
+      }
+
+      task_variant task;
+      task_tag tag;
+      std::chrono::steady_clock::time_point enqueue_time;
+      void* hook_context;
+      size_t memory_cost;
+      expire_function expire; // set when the task exceeded its deadline
+      std::condition_variable* wake = nullptr;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        auto& pinned_tasks = m_pinned_tasks[index];
+
+        if(m_hooks && !m_stop && m_tasks.empty() && pinned_tasks.empty() &&
+          m_deadline_tasks.empty() && !can_admit_budget_task() && m_fork_tasks_count.load() == 0)
+        {
+          lock.unlock();
+          m_hooks->on_idle(index);
+          lock.lock();
+        }
+
+        auto has_work = [this, &pinned_tasks]
+        {
+          return m_stop || !m_tasks.empty() || !pinned_tasks.empty() ||
+            !m_deadline_tasks.empty() || can_admit_budget_task() ||
+            m_fork_tasks_count.load() > 0;
+        };
+
+        // registered as idle before checking the queues, see push_fork_task.
+        // A worker woken for a task another one took goes back to the list.
+        while(true)
+        {
+          set_idle(index, true);
+          if(has_work())
+          {
+            break;
+          }
+
+          // the watchdog sees the last task as running until then, which
+          // saves a store per task
+          worker.task_start.store(0, std::memory_order_relaxed);
+
+          worker.wake_condition.wait(lock);
+        }
+        set_idle(index, false);
+
+        // the queued tasks are dropped, see cancel_queued_tasks, but the
+        // fork_join children are not: their scope waits for them
+        if(m_stop)
+        {
+          if(m_fork_tasks_count.load() == 0)
+          {
+            return;
+          }
+
+          continue;
+        }
+
+        queued_task queued;
+
+        bool admit_next = false;
+
+        // tasks pinned on this worker first, no other worker can run them, then
+        // the tasks with a deadline, earliest first, unless the shared task at
+        // the head is due before them, then the oldest of the heads of the
+        // shared queue and of the budget queue, when the latter fits in the
+        // budget
+        if(!pinned_tasks.empty())
+        {
+          queued = std::move(pinned_tasks.front());
+          pinned_tasks.pop();
+          --m_pinned_tasks_count;
+          ++m_pinned_tasks_dequeued[index];
+        }
+        else if(!m_deadline_tasks.empty() && !shared_task_first())
+        {
+          std::pop_heap(m_deadline_tasks.begin(), m_deadline_tasks.end(), deadline_task::later);
+          auto& earliest = m_deadline_tasks.back();
+
+          queued = std::move(earliest.queued);
+          if(earliest.deadline < std::chrono::steady_clock::now())
+          {
+            expire = std::move(earliest.expire);
+          }
+
+          m_deadline_tasks.pop_back();
+          ++m_deadline_tasks_dequeued;
+        }
+        else if(budget_task_first())
+        {
+          queued = std::move(m_budget_tasks.front());
+          m_budget_tasks.pop();
+          ++m_budget_tasks_dequeued;
+          m_memory_in_use += queued.memory_cost;
+
+          admit_next = can_admit_budget_task();
+        }
+        else if(!m_tasks.empty())
+        {
+          queued = std::move(m_tasks.front());
+          m_tasks.pop();
+          ++m_tasks_dequeued;
+        }
+        else
+        {
+          // woken up for a fork_join child
+          continue;
+        }
+
+        task         = std::move(queued.task);
+        tag          = queued.tag;
+        enqueue_time = queued.enqueue_time;
+        hook_context = queued.hook_context;
+        memory_cost  = queued.memory_cost;
+
+        if(admit_next)
+        {
+          wake = take_idle_worker();
+        }
+      }
+
+      notify(wake);
+
+      if(m_hooks)
+      {
+        m_hooks->on_task_begin(index, hook_context);
+      }
+
+      ++m_busy_count;
+
+      // a single clock read for the watchdog and the tag statistics
+      bool watched = m_watchdog_enabled.load(std::memory_order_relaxed);
+
+      std::chrono::steady_clock::time_point start_time;
+      if(watched || !tag.empty())
+      {
+        start_time = std::chrono::steady_clock::now();
+      }
+
+      if(watched)
+      {
+        worker.task_start.store(start_time.time_since_epoch().count(), std::memory_order_relaxed);
+      }
+
+      if(expire)
+      {
+        expire(std::make_exception_ptr(deadline_exceeded()));
+      }
+      else if(tag.empty())
+      {
+        invoke(task, stop_token);
+      }
+      else
+      {
+        auto start_cpu = detail::thread_cpu_time();
+
+        invoke(task, stop_token);
+
+        auto end_time = std::chrono::steady_clock::now();
+        auto end_cpu  = detail::thread_cpu_time();
+
+        std::lock_guard lock(worker.tag_stats_mutex);
+        worker.tag_stats[tag.name] += task_tag_stats{ 1,
+          start_time - enqueue_time,
+          end_time - start_time,
+          end_cpu - start_cpu };
+      }
+
+      if(m_hooks)
+      {
+        m_hooks->on_task_end(index, hook_context);
+      }
+
+      if(memory_cost > 0)
+      {
+        std::condition_variable* wake_next = nullptr;
+        {
+          std::lock_guard lock(m_mutex);
+          m_memory_in_use -= memory_cost;
+
+          if(can_admit_budget_task())
+          {
+            wake_next = take_idle_worker();
+          }
+        }
+
+        notify(wake_next);
+      }
+
+      --m_busy_count;
+
+      if(m_busy_count == 0)
+      {
+        m_pool_wait_condition.notify_all();
+      }
+    }
+  }
+
+  static void invoke(task_variant& task, std::stop_token& stop_token)
+  {
+    if(std::holds_alternative<task_type>(task))
+    {
+      std::get<task_type>(task)();
+    }
+    else
+    {
+      std::get<task_type_st>(task)(stop_token);
+    }
+  }
+
+  // A queue as seen by the watchdog between its polls: it is stalled while it
+  // is not empty and no task was taken out of it since it was first seen so
+  struct observed_queue
+  {
+    uint64_t dequeued{ 0 };
+    bool waiting{ false };
+    bool changed{ false };
+    bool reported{ false };
+    std::chrono::steady_clock::time_point since{};
+
+    // m_mutex must be held
+    void update(bool empty, uint64_t dequeued_count)
+    {
+      changed  = !empty && (!waiting || dequeued != dequeued_count);
+      waiting  = !empty;
+      dequeued = dequeued_count;
+    }
+
+    // how long the queue has been stalled when it reaches `threshold` for the
+    // first time, 0 otherwise
+    std::chrono::nanoseconds stall(std::chrono::steady_clock::time_point now, std::chrono::nanoseconds threshold)
+    {
+      if(!waiting)
+      {
+        return std::chrono::nanoseconds(0);
+      }
+
+      if(changed)
+      {
+        since    = now;
+        reported = false;
+        return std::chrono::nanoseconds(0);
+      }
+
+      auto age = std::chrono::duration_cast<std::chrono::nanoseconds>(now - since);
+      if(reported || age < threshold)
+      {
+        return std::chrono::nanoseconds(0);
+      }
+
+      reported = true;
+      return age;
+    }
+  };
+
+  // `reported_tasks` and `reported_waits` hold the start times that were
+  // already reported, so that each task/wait is reported once
+  void watchdog_work(std::stop_token stop_token,
+    watchdog_options options,
+    watchdog_callback callback,
+    std::vector<int64_t> reported_tasks)
+  {
+    std::vector<int64_t> reported_waits(m_workers.size(), 0);
+
+    // the shared, budget and deadline queues, then the queues of pinned tasks
+    std::vector<observed_queue> queues(3 + m_workers.size());
+
+    std::mutex sleep_mutex;
+    std::condition_variable_any sleep_condition;
+
+    auto check = [](std::atomic<int64_t>& slot, int64_t& reported, int64_t now, std::chrono::nanoseconds threshold)
+    {
+      auto start = slot.load(std::memory_order_relaxed);
+
+      if(start == 0 || start == reported || now - start < threshold.count())
+      {
+        return std::chrono::nanoseconds(0);
+      }
+
+      reported = start;
+      return std::chrono::nanoseconds(now - start);
+    };
+
+    while(!stop_token.stop_requested())
+    {
+      auto now = detail::steady_now();
+
+      for(size_t i = 0; i < m_workers.size(); ++i)
+      {
+        if(auto duration = check(m_workers[i]->task_start, reported_tasks[i], now, options.long_task_threshold);
+           duration.count() > 0)
+        {
+          callback({ watchdog_event::kind::long_task, i, duration });
+        }
+
+        if(auto duration = check(m_workers[i]->wait_start, reported_waits[i], now, options.blocked_in_get_threshold);
+           duration.count() > 0)
+        {
+          callback({ watchdog_event::kind::blocked_in_get, i, duration });
+        }
+      }
+
+      {
+        std::lock_guard lock(m_mutex);
+
+        queues[0].update(m_tasks.empty(), m_tasks_dequeued);
+        queues[1].update(m_budget_tasks.empty(), m_budget_tasks_dequeued);
+        queues[2].update(m_deadline_tasks.empty(), m_deadline_tasks_dequeued);
+        for(size_t i = 0; i < m_workers.size(); ++i)
+        {
+          queues[3 + i].update(m_pinned_tasks[i].empty(), m_pinned_tasks_dequeued[i]);
+        }
+      }
+
+      auto poll_time = std::chrono::steady_clock::now();
+      for(auto& queue : queues)
+      {
+        if(auto age = queue.stall(poll_time, options.queue_age_threshold); age.count() > 0)
+        {
+          callback({ watchdog_event::kind::queue_stall, watchdog_event::no_worker, age });
+        }
+      }
+
+      std::unique_lock lock(sleep_mutex);
+      sleep_condition.wait_for(lock,
+        stop_token,
+        options.poll_interval,
+        []
+        {
+          return false;
+        });
+    }
+  }
+
+  bool is_idle() const
+  {
+    return m_tasks.empty() && m_deadline_tasks.empty() && m_budget_tasks.empty() &&
+      (m_pinned_tasks_count == 0) && (m_busy_count == 0) && (m_fork_tasks_count.load() == 0);
+  }
+
+  std::shared_ptr<scheduler_hooks> m_hooks;
+  std::vector<std::unique_ptr<detail::worker_state>> m_workers;
+  std::vector<std::jthread> m_threads;
+  std::queue<queued_task> m_tasks;
+  std::vector<std::queue<queued_task>> m_pinned_tasks; // per worker, see run_on
+  size_t m_pinned_tasks_count{ 0 };
+
+  // tasks taken out of the queues, see observed_queue
+  uint64_t m_tasks_dequeued{ 0 };
+  std::vector<uint64_t> m_pinned_tasks_dequeued;
+  uint64_t m_budget_tasks_dequeued{ 0 };
+  uint64_t m_deadline_tasks_dequeued{ 0 };
+
+  std::vector<deadline_task> m_deadline_tasks; // binary heap, see deadline_task::later
+  uint64_t m_deadline_sequence{ 0 };
+  std::chrono::nanoseconds m_deadline_slack{ std::chrono::milliseconds(100) }; // see set_deadline_slack
+  std::queue<queued_task> m_budget_tasks; // see set_memory_budget
+  size_t m_memory_budget{ std::numeric_limits<size_t>::max() };
+  size_t m_memory_in_use{ 0 };
+  uint64_t m_admit_sequence{ 0 };
+
+  mutable std::mutex m_mutex;
   std::atomic<size_t> m_busy_count{ 0 };
-  std::condition_variable m_workers_wait_condition;
+  std::atomic<size_t> m_fork_tasks_count{ 0 };
+  std::atomic<size_t> m_sleeping_count{ 0 }; // size of m_idle_workers
+  std::vector<size_t> m_idle_workers;
+  std::atomic<size_t> m_next_fork_worker{ 0 };
   std::condition_variable m_pool_wait_condition;
 
   static inline int s_count_threads_global_instance = std::thread::hardware_concurrency();
   static inline int s_global_instance_initialized = false;
 
-  bool m_stop{ false };
+  std::atomic<bool> m_stop{ false };
+
+  std::atomic<bool> m_watchdog_enabled{ false };
+  std::jthread m_watchdog;
 };
 
 template <typename Func, typename... Args>
@@ -348,6 +1841,15 @@ auto map(Range&& range, Func&& function, Args&&... args)
     std::forward<Range>(range), std::forward<Func>(function), std::forward<Args>(args)...);
 }
 
+template <std::ranges::range Range, typename Func, typename... Args>
+auto map(task_tag tag, Range&& range, Func&& function, Args&&... args)
+{
+  return thread_pool::global_instance().map(tag,
+    std::forward<Range>(range),
+    std::forward<Func>(function),
+    std::forward<Args>(args)...);
+}
+
 inline void wait()
 {
   thread_pool::global_instance().wait();
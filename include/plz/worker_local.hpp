@@ -0,0 +1,129 @@
+#ifndef __WORKER_LOCAL_H__
+#define __WORKER_LOCAL_H__
+
+#include <concepts>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+namespace plz
+{
+
+/**
+ * One instance of T per worker of a thread_pool, each on its own cache lines,
+ * for scratch buffers and per worker accumulators that tasks reuse instead of
+ * allocating or sharing them.
+ *
+ * `local()` must be called from a worker of the pool and returns the instance
+ * of that worker, which no other thread touches while the worker runs a task.
+ * `combine`/`for_each` visit all the instances and should only be called when
+ * no task is using them, e.g. after thread_pool::wait().
+ *
+ * ```
+ * plz::worker_local<std::vector<float>> scratch(pool);
+ * plz::worker_local<size_t> matches(pool, 0);
+ *
+ * pool.map(files, [&](const std::string& file)
+ *   {
+ *     auto& buffer = scratch.local();
+ *     load(file, buffer);
+ *     matches.local() += count_matches(buffer);
+ *   });
+ * pool.wait();
+ *
+ * auto total = matches.combine(std::plus<>{});
+ * ```
+ */
+template <typename T>
+class worker_local
+{
+  public:
+  explicit worker_local(thread_pool& pool)
+    requires std::default_initializable<T>
+    : m_pool{ &pool }, m_slots(pool.get_thread_count())
+  {
+  }
+
+  worker_local(thread_pool& pool, const T& initial_value)
+    : m_pool{ &pool }, m_slots(pool.get_thread_count(), slot{ initial_value })
+  {
+  }
+
+  worker_local(const worker_local&)            = delete;
+  worker_local& operator=(const worker_local&) = delete;
+
+  T& local()
+  {
+    auto index = m_pool->get_current_worker_index();
+    if(!index)
+    {
+      throw std::runtime_error("worker_local accessed outside of its thread_pool");
+    }
+
+    return m_slots[*index].value;
+  }
+
+  size_t size() const
+  {
+    return m_slots.size();
+  }
+
+  T& operator[](size_t worker_index)
+  {
+    return m_slots[worker_index].value;
+  }
+
+  const T& operator[](size_t worker_index) const
+  {
+    return m_slots[worker_index].value;
+  }
+
+  template <typename Func>
+    requires std::invocable<Func, T&>
+  void for_each(Func&& func)
+  {
+    for(auto& slot : m_slots)
+    {
+      func(slot.value);
+    }
+  }
+
+  /**
+   * Folds the instances of all the workers with `op`, in worker order.
+   */
+  template <typename BinaryOp>
+    requires std::invocable<BinaryOp, T, const T&>
+  T combine(BinaryOp op) const
+  {
+    if(m_slots.empty())
+    {
+      return T{};
+    }
+
+    T result = m_slots[0].value;
+    for(size_t i = 1; i < m_slots.size(); ++i)
+    {
+      result = op(std::move(result), m_slots[i].value);
+    }
+
+    return result;
+  }
+
+  private:
+  // a slot starts on its own cache line and is padded to a whole number of
+  // them, so that neighbouring workers never share a line
+  struct alignas(64) slot
+  {
+    T value{};
+  };
+
+  thread_pool* m_pool;
+  std::vector<slot> m_slots;
+};
+
+} // namespace plz
+
+#endif // __WORKER_LOCAL_H__
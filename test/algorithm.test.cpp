@@ -0,0 +1,221 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <plz/algorithm.hpp>
+
+template <typename T>
+static std::vector<T> random_values(size_t size, T min, T max)
+{
+  std::mt19937_64 gen(42);
+  std::vector<T> values(size);
+
+  if constexpr(std::is_integral_v<T>)
+  {
+    std::uniform_int_distribution<T> distribution(min, max);
+    std::ranges::generate(values,
+      [&]
+      {
+        return distribution(gen);
+      });
+  }
+  else
+  {
+    std::uniform_real_distribution<T> distribution(min, max);
+    std::ranges::generate(values,
+      [&]
+      {
+        return distribution(gen);
+      });
+  }
+
+  return values;
+}
+
+TEST_CASE("algorithm: parallel_sort integers")
+{
+  plz::thread_pool pool(4);
+
+  auto values   = random_values<int64_t>(1 << 18, -1'000'000'000'000, 1'000'000'000'000);
+  auto expected = values;
+  std::ranges::sort(expected);
+
+  plz::parallel_sort(pool, values.begin(), values.end());
+
+  CHECK(values == expected);
+}
+
+TEST_CASE("algorithm: parallel_sort small integers")
+{
+  plz::thread_pool pool(4);
+
+  auto values   = random_values<uint16_t>(1 << 17, 0, 100);
+  auto expected = values;
+  std::ranges::sort(expected);
+
+  plz::parallel_sort(pool, values.begin(), values.end());
+
+  CHECK(values == expected);
+}
+
+TEST_CASE("algorithm: parallel_sort with a comparator")
+{
+  plz::thread_pool pool(4);
+
+  auto values   = random_values<double>(1 << 17, -1.0, 1.0);
+  auto expected = values;
+  std::ranges::sort(expected, std::greater<>{});
+
+  plz::parallel_sort(pool, values.begin(), values.end(), std::greater<>{});
+
+  CHECK(values == expected);
+}
+
+TEST_CASE("algorithm: parallel_sort strings")
+{
+  plz::thread_pool pool(3);
+
+  std::vector<std::string> values;
+  for(auto value : random_values<int>(1 << 16, 0, 1000))
+  {
+    values.push_back(std::to_string(value));
+  }
+
+  auto expected = values;
+  std::ranges::sort(expected);
+
+  plz::parallel_sort(pool, values.begin(), values.end());
+
+  CHECK(values == expected);
+}
+
+TEST_CASE("algorithm: parallel_sort short range")
+{
+  std::vector values = { 5, 3, 1, 4, 2 };
+
+  plz::parallel_sort(values.begin(), values.end());
+
+  CHECK(values == std::vector{ 1, 2, 3, 4, 5 });
+}
+
+TEST_CASE("algorithm: parallel_inclusive_scan")
+{
+  plz::thread_pool pool(4);
+
+  auto values = random_values<int64_t>(1 << 17, -1000, 1000);
+  std::vector<int64_t> expected(values.size());
+  std::inclusive_scan(values.begin(), values.end(), expected.begin());
+
+  std::vector<int64_t> result(values.size());
+  auto end = plz::parallel_inclusive_scan(pool, values.begin(), values.end(), result.begin());
+
+  CHECK(end == result.end());
+  CHECK(result == expected);
+}
+
+TEST_CASE("algorithm: parallel_exclusive_scan in place")
+{
+  plz::thread_pool pool(3);
+
+  auto values = random_values<int64_t>(1 << 17, 0, 1000);
+  std::vector<int64_t> expected(values.size());
+  std::exclusive_scan(values.begin(), values.end(), expected.begin(), int64_t(7));
+
+  plz::parallel_exclusive_scan(pool, values.begin(), values.end(), values.begin(), int64_t(7));
+
+  CHECK(values == expected);
+}
+
+TEST_CASE("algorithm: parallel scans with a non commutative operation")
+{
+  plz::thread_pool pool(4);
+
+  // composition of affine functions x -> a * x + b, associative but not commutative
+  using affine = std::pair<int64_t, int64_t>;
+  auto compose = [](const affine& f, const affine& g)
+  {
+    return affine{ (g.first * f.first) % 1000003, (g.first * f.second + g.second) % 1000003 };
+  };
+
+  std::vector<affine> values;
+  for(auto value : random_values<int64_t>(1 << 17, 1, 100))
+  {
+    values.push_back({ value, value / 2 });
+  }
+
+  std::vector<affine> expected(values.size());
+  std::inclusive_scan(values.begin(), values.end(), expected.begin(), compose);
+
+  std::vector<affine> result(values.size());
+  plz::parallel_inclusive_scan(pool, values.begin(), values.end(), result.begin(), compose);
+  CHECK(result == expected);
+
+  std::exclusive_scan(values.begin(), values.end(), expected.begin(), affine{ 1, 0 }, compose);
+  plz::parallel_exclusive_scan(
+    pool, values.begin(), values.end(), result.begin(), affine{ 1, 0 }, compose);
+  CHECK(result == expected);
+}
+
+TEST_CASE("algorithm: parallel scans short range")
+{
+  std::vector values = { 1, 2, 3, 4 };
+  std::vector<int> result(values.size());
+
+  plz::parallel_inclusive_scan(values.begin(), values.end(), result.begin());
+  CHECK(result == std::vector{ 1, 3, 6, 10 });
+
+  plz::parallel_exclusive_scan(values.begin(), values.end(), result.begin(), 0);
+  CHECK(result == std::vector{ 0, 1, 3, 6 });
+}
+
+namespace
+{
+
+// rejects every task after the first `accepted` ones
+struct rejecting_hooks : plz::scheduler_hooks
+{
+  std::atomic<size_t> accepted;
+
+  explicit rejecting_hooks(size_t accepted) : accepted{ accepted }
+  {
+  }
+
+  void* on_enqueue() override
+  {
+    if(accepted == 0)
+    {
+      throw std::runtime_error("rejected");
+    }
+
+    --accepted;
+    return nullptr;
+  }
+};
+
+} // namespace
+
+TEST_CASE("algorithm: parallel_for_each_index waits for posted tasks when posting throws")
+{
+  plz::thread_pool pool(2, std::make_shared<rejecting_hooks>(2));
+  std::atomic<size_t> done{ 0 };
+
+  CHECK_THROWS_AS(plz::detail::parallel_for_each_index(pool,
+                    8,
+                    [&done](size_t)
+                    {
+                      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                      ++done;
+                    }),
+    std::runtime_error);
+
+  CHECK(done == 2);
+}
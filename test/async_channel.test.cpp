@@ -0,0 +1,134 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "plz/circbuff/async_channel.hpp"
+
+using buffer_ptr = std::shared_ptr<std::array<int, 16>>;
+
+static plz::async_generator<int> numbers(int count)
+{
+  for(int i = 0; i < count; ++i)
+  {
+    co_yield i;
+  }
+}
+
+static plz::async_generator<int> failing_numbers()
+{
+  co_yield 1;
+  throw std::runtime_error("generator failed");
+}
+
+static plz::async_task<std::vector<int>> collect(plz::sink<buffer_ptr>& sink, plz::thread_pool& pool)
+{
+  std::vector<int> values;
+
+  while(true)
+  {
+    auto batch = co_await plz::next_batch(sink, 5, pool);
+    if(batch.empty())
+    {
+      co_return values;
+    }
+
+    values.insert(values.end(), batch.begin(), batch.end());
+  }
+}
+
+static plz::async_task<int> sum(plz::async_generator<int> generator)
+{
+  int total = 0;
+  while(auto value = co_await generator.next())
+  {
+    total += *value;
+  }
+  co_return total;
+}
+
+TEST_CASE("async_channel: async_generator")
+{
+  CHECK(sum(numbers(5)).get_future().get() == 10);
+  CHECK_THROWS_AS(sum(failing_numbers()).get_future().get(), std::runtime_error);
+}
+
+TEST_CASE("async_channel: generator piped to a coroutine consumer with backpressure")
+{
+  plz::thread_pool pool(2);
+
+  auto [source, sink] = plz::make_channel(std::make_shared<std::array<int, 16>>());
+
+  // the consumer starts first and suspends on the empty channel
+  auto values = collect(sink, pool).get_future();
+  auto done   = plz::pipe_to(numbers(1000), source, pool);
+
+  done.get();
+
+  std::vector<int> expected(1000);
+  std::iota(expected.begin(), expected.end(), 0);
+
+  // nothing was overwritten although the buffer only holds 16 values
+  CHECK(values.get() == expected);
+}
+
+TEST_CASE("async_channel: free space follows the slowest sink")
+{
+  auto [source, sinks] = plz::make_spmc_channel<2>(std::make_shared<std::array<int, 16>>());
+
+  CHECK(source.get_free_space() == 16);
+
+  for(int i = 0; i < 10; ++i)
+  {
+    source.put(i);
+  }
+
+  sinks[0].read(10);
+  CHECK(source.get_free_space() == 6);
+
+  {
+    // a copy is another sink that starts where the original is
+    auto lagging = sinks[1].clone();
+
+    sinks[1].read(4);
+    CHECK(source.get_free_space() == 6);
+  }
+
+  CHECK(source.get_free_space() == 10);
+}
+
+TEST_CASE("async_channel: a moved-from sink no longer holds back the free space")
+{
+  auto [source, sinks] = plz::make_spmc_channel<1>(std::make_shared<std::array<int, 4>>());
+
+  auto moved = std::move(sinks[0]);
+  for(int i = 0; i < 4; ++i)
+  {
+    CHECK(source.try_emplace(i));
+  }
+
+  CHECK_FALSE(source.try_emplace(4));
+  CHECK(moved.read(4) == std::vector{ 0, 1, 2, 3 });
+  CHECK(source.try_emplace(4));
+  CHECK(source.get_free_space() == 3);
+
+  sinks[0] = std::move(moved);
+  CHECK(sinks[0].get() == 4);
+  CHECK(source.get_free_space() == 4);
+}
+
+TEST_CASE("async_channel: closing wakes the consumer")
+{
+  plz::thread_pool pool(1);
+
+  auto [source, sink] = plz::make_channel(std::make_shared<std::array<int, 16>>());
+
+  auto values = collect(sink, pool).get_future();
+  source.put(7);
+  source.close();
+
+  CHECK(values.get() == std::vector{ 7 });
+}
@@ -5,8 +5,10 @@
 #include <cctype>
 #include <chrono>
 #include <expected>
+#include <functional>
 #include <numeric>
 #include <random>
+#include <span>
 #include <string>
 
 #include <plz/packaged_task.hpp>
@@ -243,6 +245,65 @@ TEST_CASE("async_tasks: map")
   CHECK(sum == 44);
 }
 
+TEST_CASE("async_tasks: map results are released with their futures")
+{
+  plz::thread_pool pool(4);
+
+  auto result = std::make_shared<int>(1);
+
+  {
+    std::array values = { 1, 2, 3, 4 };
+    auto results      = pool.map(values,
+      [result](int)
+      {
+        return result;
+      });
+
+    CHECK(results.get().size() == 4);
+  }
+
+  pool.wait();
+
+  CHECK(result.use_count() == 1);
+}
+
+TEST_CASE("async_tasks: map with move-only arguments")
+{
+  plz::thread_pool pool(2);
+
+  std::array values = { 2 };
+  auto results      = pool.map(
+    values,
+    [](int i, const std::unique_ptr<int>& offset)
+    {
+      return i + *offset;
+    },
+    std::make_unique<int>(1));
+
+  CHECK(results.get() == std::vector{ 3 });
+
+  // every task gets its own copy of an rvalue argument
+  std::array keys = { 1, 2, 3 };
+  auto sizes      = pool.map(
+    keys,
+    [](int i, const std::string& text)
+    {
+      return text.size() + i;
+    },
+    std::string("plz"));
+
+  CHECK(sizes.get() == std::vector<size_t>{ 4, 5, 6 });
+
+  CHECK_THROWS_AS(pool.map(
+                    keys,
+                    [](int i, const std::unique_ptr<int>& offset)
+                    {
+                      return i + *offset;
+                    },
+                    std::make_unique<int>(1)),
+    std::invalid_argument);
+}
+
 TEST_CASE("async_tasks: map on string chars")
 {
   plz::thread_pool pool(4);
@@ -490,3 +551,671 @@ TEST_CASE("async_tasks: close tasks with jthread's stop token")
   pool.quit();
   pool.wait();
 }
+
+TEST_CASE("async_tasks: parallel dispatch of continuations")
+{
+  plz::thread_pool pool(4);
+
+  constexpr int handlers_count = 100;
+  std::atomic<int> sum{ 0 };
+  std::atomic<int> calls{ 0 };
+
+  auto future = pool.run(
+    []
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      return 2;
+    });
+
+  future.set_parallel_dispatch(10, 8);
+
+  for(int i = 0; i < handlers_count; ++i)
+  {
+    future.then(
+      [&sum, &calls](int value)
+      {
+        sum += value;
+        calls++;
+      });
+  }
+
+  CHECK(future.get() == 2);
+
+  pool.wait();
+
+  CHECK(calls == handlers_count);
+  CHECK(sum == 2 * handlers_count);
+}
+
+TEST_CASE("async_tasks: waiting for a future runs its dispatched continuations")
+{
+  plz::thread_pool pool(1);
+
+  std::atomic<size_t> calls{ 0 };
+
+  auto future = pool.run(
+    []
+    {
+      std::this_thread::sleep_for(50ms);
+      return std::vector<int>{ 1, 2, 3 };
+    });
+
+  future.set_parallel_dispatch(4, 2);
+
+  for(int i = 0; i < 40; ++i)
+  {
+    future.then(
+      [&calls](const std::vector<int>& values)
+      {
+        calls += values.size();
+      });
+  }
+
+  // queued before the shards, so the only worker runs them from get()
+  auto waiter = pool.run(
+    [future]() mutable
+    {
+      return future.get().size();
+    });
+
+  CHECK(waiter.get() == 3);
+  CHECK(calls == 120);
+  CHECK(future.take().size() == 3);
+}
+
+TEST_CASE("async_tasks: dispatched continuations can wait for their own future")
+{
+  plz::thread_pool pool(4);
+
+  std::atomic<int> sum{ 0 };
+
+  auto future = pool.run(
+    []
+    {
+      std::this_thread::sleep_for(50ms);
+      return 2;
+    });
+
+  future.set_parallel_dispatch(4, 2);
+
+  // the shards run on the workers and on the thread that sets the result,
+  // none of them waits for the shard it is running
+  for(int i = 0; i < 40; ++i)
+  {
+    future.then(
+      [future, &sum](int) mutable
+      {
+        sum += future.get();
+      });
+  }
+
+  CHECK(future.get() == 2);
+  CHECK(sum == 80);
+}
+
+TEST_CASE("async_tasks: watchdog reports long tasks, blocked workers and queue stalls")
+{
+  plz::thread_pool pool(1);
+
+  std::mutex mutex;
+  std::vector<plz::watchdog_event> events;
+
+  pool.start_watchdog(
+    plz::watchdog_options{ .long_task_threshold = 50ms,
+      .blocked_in_get_threshold                 = 50ms,
+      .queue_age_threshold                      = 50ms,
+      .poll_interval                            = 5ms },
+    [&mutex, &events](const plz::watchdog_event& event)
+    {
+      std::lock_guard lock(mutex);
+      events.push_back(event);
+    });
+
+  auto promise = plz::make_promise<int>();
+
+  pool.run(
+    [future = promise.get_future()]() mutable
+    {
+      return future.get();
+    });
+
+  auto queued = pool.run(
+    []
+    {
+      return 1;
+    });
+
+  std::this_thread::sleep_for(200ms);
+  promise.set_result(0);
+
+  CHECK(queued.get() == 1);
+  pool.stop_watchdog();
+
+  auto count = [&events](plz::watchdog_event::kind kind)
+  {
+    return std::ranges::count_if(events,
+      [kind](const auto& event)
+      {
+        return event.type == kind;
+      });
+  };
+
+  CHECK(count(plz::watchdog_event::kind::long_task) >= 1);
+  CHECK(count(plz::watchdog_event::kind::blocked_in_get) >= 1);
+  CHECK(count(plz::watchdog_event::kind::queue_stall) >= 1);
+  CHECK(events.front().duration >= 50ms);
+}
+
+TEST_CASE("async_tasks: watchdog reports stalled pinned tasks")
+{
+  plz::thread_pool pool(2);
+
+  std::atomic<int> stalls{ 0 };
+
+  pool.start_watchdog(
+    plz::watchdog_options{ .queue_age_threshold = 50ms, .poll_interval = 5ms },
+    [&stalls](const plz::watchdog_event& event)
+    {
+      if(event.type == plz::watchdog_event::kind::queue_stall)
+      {
+        ++stalls;
+      }
+    });
+
+  auto promise = plz::make_promise<void>();
+
+  pool.run_on(0,
+    [future = promise.get_future()]() mutable
+    {
+      future.get();
+    });
+
+  // the other worker is idle but cannot run it
+  auto pinned = pool.run_on(0,
+    []
+    {
+      return 1;
+    });
+
+  std::this_thread::sleep_for(200ms);
+  promise.set_ready();
+
+  CHECK(pinned.get() == 1);
+  pool.stop_watchdog();
+
+  CHECK(stalls >= 1);
+}
+
+TEST_CASE("async_tasks: watchdog reports stalled budgeted tasks")
+{
+  plz::thread_pool pool(2);
+  pool.set_memory_budget(100);
+
+  std::atomic<int> stalls{ 0 };
+
+  pool.start_watchdog(
+    plz::watchdog_options{ .queue_age_threshold = 50ms, .poll_interval = 5ms },
+    [&stalls](const plz::watchdog_event& event)
+    {
+      if(event.type == plz::watchdog_event::kind::queue_stall)
+      {
+        ++stalls;
+      }
+    });
+
+  auto promise = plz::make_promise<void>();
+
+  pool.run(plz::memory_cost{ 100 },
+    [future = promise.get_future()](std::stop_token) mutable
+    {
+      future.get();
+    });
+
+  // the other worker is idle but the budget is spent
+  auto budgeted = pool.run(plz::memory_cost{ 100 },
+    [](std::stop_token)
+    {
+      return 1;
+    });
+
+  std::this_thread::sleep_for(200ms);
+  promise.set_ready();
+
+  CHECK(budgeted.get() == 1);
+  pool.stop_watchdog();
+
+  CHECK(stalls >= 1);
+}
+
+TEST_CASE("async_tasks: watchdog reports stalled tasks with a deadline")
+{
+  plz::thread_pool pool(1);
+
+  std::atomic<int> stalls{ 0 };
+
+  pool.start_watchdog(
+    plz::watchdog_options{ .queue_age_threshold = 50ms, .poll_interval = 5ms },
+    [&stalls](const plz::watchdog_event& event)
+    {
+      if(event.type == plz::watchdog_event::kind::queue_stall)
+      {
+        ++stalls;
+      }
+    });
+
+  auto promise = plz::make_promise<void>();
+
+  pool.run(
+    [future = promise.get_future()]() mutable
+    {
+      future.get();
+    });
+
+  auto urgent = pool.run(plz::deadline(10s),
+    []
+    {
+      return 1;
+    });
+
+  std::this_thread::sleep_for(200ms);
+  promise.set_ready();
+
+  CHECK(urgent.get() == 1);
+  pool.stop_watchdog();
+
+  CHECK(stalls >= 1);
+}
+
+TEST_CASE("async_tasks: tagged tasks statistics")
+{
+  plz::thread_pool pool(2);
+
+  pool.run("sleep",
+    []
+    {
+      std::this_thread::sleep_for(50ms);
+    });
+
+  pool.run("spin",
+    []
+    {
+      auto end = std::chrono::steady_clock::now() + 50ms;
+      while(std::chrono::steady_clock::now() < end)
+      {
+      }
+    });
+
+  std::array values = { 1, 2, 3, 4 };
+  CHECK(pool
+          .map("map",
+            values,
+            [](int i)
+            {
+              return i * 2;
+            })
+          .get() == std::vector{ 2, 4, 6, 8 });
+
+  pool.run(
+    []
+    {
+    });
+
+  pool.wait();
+
+  auto stats = pool.get_tag_stats();
+
+  CHECK(stats.size() == 3);
+  CHECK(stats["sleep"].count == 1);
+  CHECK(stats["sleep"].wall_time >= 50ms);
+  CHECK(stats["sleep"].cpu_time < stats["sleep"].wall_time);
+  CHECK(stats["spin"].count == 1);
+  CHECK(stats["spin"].cpu_time > stats["sleep"].cpu_time);
+  CHECK(stats["map"].count == values.size());
+
+  pool.reset_tag_stats();
+  CHECK(pool.get_tag_stats().empty());
+}
+
+namespace
+{
+thread_local int g_request_id = 0;
+
+struct request_context_hooks : plz::scheduler_hooks
+{
+  std::atomic<int> enqueued{ 0 };
+  std::atomic<int> begun{ 0 };
+  std::atomic<int> ended{ 0 };
+  std::atomic<int> idle{ 0 };
+  std::atomic<int> cancelled{ 0 };
+
+  void* on_enqueue() override
+  {
+    enqueued++;
+    return reinterpret_cast<void*>(static_cast<intptr_t>(g_request_id));
+  }
+
+  void on_task_begin(size_t, void* context) override
+  {
+    begun++;
+    g_request_id = static_cast<int>(reinterpret_cast<intptr_t>(context));
+  }
+
+  void on_task_end(size_t, void*) override
+  {
+    ended++;
+    g_request_id = 0;
+  }
+
+  void on_task_cancel(void*) override
+  {
+    cancelled++;
+  }
+
+  void on_idle(size_t) override
+  {
+    idle++;
+  }
+};
+} // namespace
+
+TEST_CASE("async_tasks: scheduler hooks")
+{
+  auto hooks = std::make_shared<request_context_hooks>();
+  plz::thread_pool pool(2, hooks);
+
+  g_request_id = 42;
+
+  auto request_id = pool.run(
+    []
+    {
+      return g_request_id;
+    });
+
+  std::array values = { 1, 2, 3 };
+  auto ids          = pool.map(values,
+    [](int)
+    {
+      return g_request_id;
+    });
+
+  CHECK(request_id.get() == 42);
+  CHECK(ids.get() == std::vector{ 42, 42, 42 });
+
+  g_request_id = 0;
+  pool.wait();
+
+  CHECK(hooks->enqueued == 4);
+  CHECK(hooks->begun == 4);
+  CHECK(hooks->ended == 4);
+  CHECK(hooks->idle > 0);
+}
+
+TEST_CASE("async_tasks: scheduler hooks of rejected and dropped tasks")
+{
+  auto hooks = std::make_shared<request_context_hooks>();
+  plz::thread_pool pool(1, hooks);
+
+  auto started = plz::make_promise<void>();
+  auto gate    = plz::make_promise<void>();
+
+  pool.run(
+    [started, future = gate.get_future()]() mutable
+    {
+      started.set_ready();
+      future.get();
+    });
+
+  started.get_future().get();
+
+  // still queued behind the blocked task when the pool quits
+  pool.run([] {});
+  pool.run([] {});
+
+  std::jthread release(
+    [&gate]
+    {
+      std::this_thread::sleep_for(50ms);
+      gate.set_ready();
+    });
+
+  pool.quit();
+
+  CHECK_THROWS_AS(pool.run([] {}), std::runtime_error);
+
+  CHECK(hooks->enqueued == 3);
+  CHECK(hooks->begun == 1);
+  CHECK(hooks->ended == 1);
+  CHECK(hooks->cancelled == 2);
+}
+
+TEST_CASE("async_tasks: run tasks on a given worker")
+{
+  plz::thread_pool pool(4);
+
+  std::vector<plz::future<std::optional<size_t>>> futures;
+  for(int i = 0; i < 20; ++i)
+  {
+    futures.push_back(pool.run_on(2,
+      [&pool]
+      {
+        return pool.get_current_worker_index();
+      }));
+  }
+
+  for(auto& future : futures)
+  {
+    CHECK(future.get() == 2);
+  }
+
+  std::string shard = "customers";
+  auto first        = pool.run_with_affinity(shard,
+    [&pool]
+    {
+      return pool.get_current_worker_index();
+    });
+  auto second = pool.run_with_affinity(shard,
+    [&pool](std::stop_token)
+    {
+      return pool.get_current_worker_index();
+    });
+
+  CHECK(first.get() == second.get());
+
+  CHECK_THROWS_AS(pool.run_on(4, [] {}), std::out_of_range);
+
+  plz::thread_pool empty_pool(0);
+  CHECK_THROWS_AS(empty_pool.run_with_affinity(shard, [] {}), std::out_of_range);
+
+  pool.wait();
+}
+
+TEST_CASE("async_tasks: earliest deadline first and expired tasks")
+{
+  plz::thread_pool pool(1);
+
+  // keep the only worker busy while the tasks are queued
+  std::atomic<bool> started{ false };
+  std::atomic<bool> release{ false };
+  pool.run(
+    [&started, &release]
+    {
+      started = true;
+      while(!release)
+      {
+        std::this_thread::sleep_for(1ms);
+      }
+    });
+
+  while(!started)
+  {
+    std::this_thread::sleep_for(1ms);
+  }
+
+  std::mutex order_mutex;
+  std::vector<int> order;
+
+  auto push_order = [&](int i)
+  {
+    std::lock_guard lock(order_mutex);
+    order.push_back(i);
+    return i;
+  };
+
+  auto now = std::chrono::steady_clock::now();
+
+  // due at now + 1s, between the expired task and the others
+  pool.set_deadline_slack(1s);
+
+  auto late     = pool.run(plz::deadline(now + 10s), push_order, 3);
+  auto early    = pool.run(plz::deadline(now + 5s), push_order, 1);
+  auto middle   = pool.run(plz::deadline(now + 8s),
+    [&](std::stop_token)
+    {
+      return push_order(2);
+    });
+  auto expired  = pool.run(plz::deadline(1ms), push_order, 4);
+  auto untagged = pool.run(push_order, 0);
+
+  std::this_thread::sleep_for(20ms);
+  release = true;
+
+  CHECK_THROWS_AS(expired.get(), plz::deadline_exceeded);
+  CHECK(early.get() == 1);
+  CHECK(middle.get() == 2);
+  CHECK(late.get() == 3);
+  CHECK(untagged.get() == 0);
+
+  pool.wait();
+
+  CHECK(order == std::vector{ 0, 1, 2, 3 });
+}
+
+TEST_CASE("async_tasks: memory budget admission")
+{
+  plz::thread_pool pool(4);
+  pool.set_memory_budget(100);
+
+  std::atomic<size_t> in_use{ 0 };
+  std::atomic<size_t> max_in_use{ 0 };
+
+  auto decompress = [&](int file)
+  {
+    auto current = in_use += 40;
+
+    auto max = max_in_use.load();
+    while(current > max && !max_in_use.compare_exchange_weak(max, current))
+    {
+    }
+
+    std::this_thread::sleep_for(10ms);
+    in_use -= 40;
+    return file;
+  };
+
+  std::vector<int> files(12);
+  std::iota(files.begin(), files.end(), 0);
+
+  auto results = pool.map(plz::memory_cost{ 40 }, files, decompress);
+  auto single  = pool.run(plz::memory_cost{ 40 }, decompress, 12);
+
+  // costs more than the budget: runs alone
+  auto huge = pool.run(plz::memory_cost{ 500 },
+    [&](std::stop_token)
+    {
+      return in_use.load();
+    });
+
+  CHECK(results.get() == files);
+  CHECK(single.get() == 12);
+  CHECK(huge.get() == 0);
+
+  pool.wait();
+
+  CHECK(max_in_use <= 80);
+  CHECK(pool.get_memory_in_use() == 0);
+}
+
+TEST_CASE("async_tasks: plain tasks are not held back by a budgeted map")
+{
+  plz::thread_pool pool(1);
+  pool.set_memory_budget(100);
+
+  auto promise = plz::make_promise<void>();
+  pool.run(
+    [future = promise.get_future()]() mutable
+    {
+      future.get();
+    });
+
+  std::atomic<size_t> decompressed{ 0 };
+
+  std::vector<int> files(50);
+  std::iota(files.begin(), files.end(), 0);
+
+  auto results = pool.map(plz::memory_cost{ 40 },
+    files,
+    [&decompressed](int file)
+    {
+      std::this_thread::sleep_for(1ms);
+      ++decompressed;
+      return file;
+    });
+
+  auto plain = pool.run(
+    [&decompressed]
+    {
+      return decompressed.load();
+    });
+
+  auto later_results = pool.map(plz::memory_cost{ 40 },
+    files,
+    [&decompressed](int file)
+    {
+      ++decompressed;
+      return file;
+    });
+
+  promise.set_ready();
+
+  // runs after the map queued before it, not after every budgeted task
+  CHECK(plain.get() == files.size());
+  CHECK(results.get() == files);
+  CHECK(later_results.get() == files);
+}
+
+TEST_CASE("async_tasks: batch submission")
+{
+  plz::thread_pool pool(3);
+
+  std::vector<std::function<int()>> tasks;
+  for(int i = 0; i < 100; ++i)
+  {
+    tasks.push_back(
+      [i]
+      {
+        return i * i;
+      });
+  }
+
+  auto futures = pool.run_batch(std::span(tasks));
+  REQUIRE(futures.size() == tasks.size());
+
+  for(int i = 0; i < 100; ++i)
+  {
+    CHECK(futures[i].get() == i * i);
+  }
+
+  std::array<int (*)(), 2> functions = { []
+    {
+      return 1;
+    },
+    []
+    {
+      return 2;
+    } };
+
+  auto more = pool.submit_bulk(functions.begin(), functions.end());
+  CHECK(more[0].get() + more[1].get() == 3);
+
+  pool.wait();
+}
@@ -1,5 +1,7 @@
 #include <catch2/catch_test_macros.hpp>
 
+#include <memory>
+#include <string>
 #include <thread>
 
 #include "plz/circbuff/channel.hpp"
@@ -335,4 +337,26 @@ TEST_CASE("channel: multiple sources")
   src2.put('2');
 
   CHECK(sink.read(3) == std::vector{ '0', '1', '2' });
-}
\ No newline at end of file
+}
+
+TEST_CASE("channel: try_emplace")
+{
+  auto [src, sinks] = plz::make_spmc_channel<2>(std::make_shared<std::array<std::string, 4>>());
+
+  for(int i = 0; i < 4; ++i)
+  {
+    CHECK(src.try_emplace(20, static_cast<char>('a' + i)));
+  }
+
+  // full until the slowest sink reads
+  CHECK_FALSE(src.try_emplace("e"));
+  CHECK(sinks[0].read(4).size() == 4);
+  CHECK_FALSE(src.try_emplace("e"));
+
+  // every sink gets its own copy
+  CHECK(sinks[1].get() == std::string(20, 'a'));
+  CHECK(src.try_emplace("e"));
+  CHECK(sinks[0].read_all() == std::vector<std::string>{ "e" });
+  CHECK(sinks[1].read_all() ==
+    std::vector<std::string>{ std::string(20, 'b'), std::string(20, 'c'), std::string(20, 'd'), "e" });
+}
@@ -1,6 +1,9 @@
 #include <catch2/catch_test_macros.hpp>
 #include <cstring>
+#include <memory>
+#include <string>
 #include <type_traits>
+#include <vector>
 
 #include "plz/circbuff/reader.hpp"
 #include "plz/circbuff/writer.hpp"
@@ -343,4 +346,36 @@ TEST_CASE("circbuff: minimum contigious buffer read")
 
   auto peeked = reader2.peek(4);
   REQUIRE(peeked == std::vector<char>({ 'e', 'f', 'g', 'h' }));
-}
\ No newline at end of file
+}
+
+TEST_CASE("circbuff: non trivially copyable values")
+{
+  std::array<std::string, 4> array;
+  plz::circbuff::writer writer(&array);
+  plz::circbuff::reader reader(&array);
+
+  // long enough to be heap allocated, a memcpy would share the allocation
+  const std::vector<std::string> values = { std::string(100, 'a'),
+    std::string(100, 'b'),
+    std::string(100, 'c') };
+
+  writer.write(values.data(), values.size());
+  writer.emplace(50, 'd');
+
+  CHECK(reader.peek(2) == std::vector<std::string>{ values[0], values[1] });
+  CHECK(reader.read(4) ==
+    std::vector<std::string>{ values[0], values[1], values[2], std::string(50, 'd') });
+
+  // wraps around the end of the buffer
+  writer.write(values.data(), values.size());
+  CHECK(reader.read(3) == values);
+}
+
+TEST_CASE("circbuff: move-only values are rejected")
+{
+  // reader and writer static_assert on it with a message instead of failing
+  // deep in a copy
+  static_assert(plz::circbuff::transferable_element<std::string>);
+  static_assert(plz::circbuff::transferable_element<int>);
+  static_assert(plz::circbuff::transferable_element<std::unique_ptr<int>> == false);
+}
@@ -0,0 +1,87 @@
+#include <catch2/catch_test_macros.hpp>
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <system_error>
+#include <vector>
+
+#include "plz/circbuff/file_source.hpp"
+
+struct record
+{
+  int id;
+  float value;
+};
+
+using buffer_ptr = std::shared_ptr<std::array<record, 64>>;
+
+static std::filesystem::path write_records(size_t count, size_t trailing_bytes = 0)
+{
+  auto path = std::filesystem::temp_directory_path() / "plz_file_source.test.bin";
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  for(size_t i = 0; i < count; ++i)
+  {
+    record value{ static_cast<int>(i), static_cast<float>(i) / 2 };
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  for(size_t i = 0; i < trailing_bytes; ++i)
+  {
+    file.put(0);
+  }
+
+  return path;
+}
+
+TEST_CASE("file_source: streams the records of a file into a channel")
+{
+  auto path = write_records(1000, 3);
+
+  plz::file_source<buffer_ptr> file(path.string(), 4096);
+  CHECK(file.get_record_count() == 1000);
+
+  auto [source, sink] = plz::make_channel(std::make_shared<std::array<record, 64>>());
+
+  std::vector<int> ids;
+  while(!file.is_done())
+  {
+    // never writes more than the free space of the channel
+    CHECK(file.write_to(source, 100) <= 64);
+
+    for(auto& value : sink.read_all())
+    {
+      CHECK(value.value == static_cast<float>(value.id) / 2);
+      ids.push_back(value.id);
+    }
+  }
+
+  std::vector<int> expected(1000);
+  std::iota(expected.begin(), expected.end(), 0);
+  CHECK(ids == expected);
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("file_source: empty and missing files")
+{
+  auto path = write_records(0);
+
+  plz::file_source<buffer_ptr> file(path.string());
+  CHECK(file.is_done());
+
+  auto [source, sink] = plz::make_channel(std::make_shared<std::array<record, 64>>());
+  CHECK(file.write_to(source) == 0);
+
+  std::filesystem::remove(path);
+
+  CHECK_THROWS_AS(plz::file_source<buffer_ptr>(path.string()), std::system_error);
+}
+
+#endif
@@ -0,0 +1,254 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <plz/fork_join.hpp>
+
+static long serial_fib(long n)
+{
+  return n < 2 ? n : serial_fib(n - 1) + serial_fib(n - 2);
+}
+
+static long fib(long n)
+{
+  if(n < 15)
+  {
+    return serial_fib(n);
+  }
+
+  long a = 0;
+  long b = 0;
+
+  plz::fork_join scope;
+  scope.spawn(
+    [&]
+    {
+      a = fib(n - 1);
+    });
+  b = fib(n - 2);
+  scope.sync();
+
+  return a + b;
+}
+
+TEST_CASE("fork_join: recursive spawn and sync")
+{
+  plz::thread_pool pool(4);
+
+  auto result = pool.run(
+    []
+    {
+      return fib(27);
+    });
+
+  CHECK(result.get() == serial_fib(27));
+}
+
+TEST_CASE("fork_join: spawn from outside the pool")
+{
+  plz::thread_pool pool(3);
+
+  std::vector<int> values(1000);
+  std::mutex threads_mutex;
+  std::set<std::thread::id> threads;
+
+  {
+    plz::fork_join scope(pool);
+
+    for(size_t i = 0; i < values.size(); ++i)
+    {
+      scope.spawn(
+        [&, i]
+        {
+          values[i] = int(i);
+
+          std::lock_guard lock(threads_mutex);
+          threads.insert(std::this_thread::get_id());
+        });
+    }
+
+    scope.sync();
+
+    CHECK(threads.count(std::this_thread::get_id()) == 0);
+  }
+
+  std::vector<int> expected(values.size());
+  std::iota(expected.begin(), expected.end(), 0);
+
+  CHECK(values == expected);
+}
+
+namespace
+{
+struct counting_hooks : plz::scheduler_hooks
+{
+  std::atomic<int> begun{ 0 };
+  std::atomic<int> ended{ 0 };
+
+  void on_task_begin(size_t, void*) override
+  {
+    begun++;
+  }
+
+  void on_task_end(size_t, void*) override
+  {
+    ended++;
+  }
+};
+} // namespace
+
+TEST_CASE("fork_join: children run between the task hooks")
+{
+  auto hooks = std::make_shared<counting_hooks>();
+  plz::thread_pool pool(2, hooks);
+
+  {
+    plz::fork_join scope(pool);
+
+    for(int i = 0; i < 100; ++i)
+    {
+      scope.spawn(
+        []
+        {
+        });
+    }
+
+    scope.sync();
+  }
+
+  pool.wait();
+
+  CHECK(hooks->begun == 100);
+  CHECK(hooks->ended == 100);
+}
+
+TEST_CASE("fork_join: sync rethrows the first exception and the scope is reusable")
+{
+  plz::thread_pool pool(2);
+
+  plz::fork_join scope(pool);
+  std::atomic<int> count{ 0 };
+
+  for(int i = 0; i < 10; ++i)
+  {
+    scope.spawn(
+      [&count, i]
+      {
+        ++count;
+        if(i == 5)
+        {
+          throw std::runtime_error("child failed");
+        }
+      });
+  }
+
+  CHECK_THROWS_AS(scope.sync(), std::runtime_error);
+  CHECK(count == 10);
+
+  // large callables are stored outside the scope
+  std::array<char, 512> payload{};
+  payload[511] = 1;
+
+  scope.spawn(
+    [&count, payload]
+    {
+      count += payload[511];
+    });
+  scope.sync();
+
+  CHECK(count == 11);
+}
+
+TEST_CASE("fork_join: children queued when the pool quits still run")
+{
+  plz::thread_pool pool(1);
+
+  auto started = plz::make_promise<void>();
+  auto gate    = plz::make_promise<void>();
+
+  pool.run(
+    [started, future = gate.get_future()]() mutable
+    {
+      started.set_ready();
+      future.get();
+    });
+
+  started.get_future().get();
+
+  std::atomic<int> count{ 0 };
+  plz::fork_join scope(pool);
+
+  for(int i = 0; i < 4; ++i)
+  {
+    scope.spawn(
+      [&count]
+      {
+        ++count;
+      });
+  }
+
+  // quit returns once the worker is done with the blocked task and the
+  // children queued behind it
+  std::jthread quitter(
+    [&pool]
+    {
+      pool.quit();
+    });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  gate.set_ready();
+
+  scope.sync();
+  CHECK(count == 4);
+
+  quitter.join();
+  CHECK_THROWS_AS(scope.spawn([] {}), std::runtime_error);
+}
+
+TEST_CASE("fork_join: parallel_invoke")
+{
+  plz::thread_pool pool(4);
+
+  std::vector<int> values(4, 0);
+
+  plz::parallel_invoke(
+    pool,
+    [&]
+    {
+      values[0] = 1;
+    },
+    [&]
+    {
+      values[1] = 2;
+    },
+    [&]
+    {
+      values[2] = 3;
+    },
+    [&]
+    {
+      values[3] = 4;
+    });
+
+  CHECK(values == std::vector{ 1, 2, 3, 4 });
+
+  CHECK_THROWS_AS(plz::parallel_invoke(
+                    pool,
+                    [] {},
+                    []
+                    {
+                      throw std::logic_error("failed");
+                    }),
+    std::logic_error);
+
+  pool.wait();
+}
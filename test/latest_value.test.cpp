@@ -0,0 +1,135 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "plz/circbuff/latest_value.hpp"
+
+// all the fields hold the same value, a torn read would mix two of them
+struct snapshot
+{
+  std::array<uint64_t, 13> fields{};
+
+  explicit snapshot(uint64_t value = 0)
+  {
+    fields.fill(value);
+  }
+
+  bool is_consistent() const
+  {
+    for(auto field : fields)
+    {
+      if(field != fields[0])
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+TEST_CASE("latest_value: seqlock")
+{
+  plz::seqlock<snapshot> latest;
+
+  CHECK(latest.load().fields[0] == 0);
+  CHECK(latest.get_version() == 0);
+
+  latest.publish(snapshot(7));
+  CHECK(latest.load().fields[12] == 7);
+  CHECK(latest.get_version() == 1);
+}
+
+TEST_CASE("latest_value: seqlock readers never see torn values")
+{
+  plz::seqlock<snapshot> latest;
+  std::atomic<bool> done{ false };
+
+  std::vector<std::thread> readers;
+  std::atomic<size_t> torn{ 0 };
+
+  for(int r = 0; r < 3; ++r)
+  {
+    readers.emplace_back(
+      [&]
+      {
+        uint64_t previous = 0;
+        while(!done)
+        {
+          auto value = latest.load();
+          if(!value.is_consistent() || value.fields[0] < previous)
+          {
+            torn++;
+          }
+          previous = value.fields[0];
+        }
+      });
+  }
+
+  for(uint64_t i = 1; i <= 100000; ++i)
+  {
+    latest.publish(snapshot(i));
+  }
+  done = true;
+
+  for(auto& reader : readers)
+  {
+    reader.join();
+  }
+
+  CHECK(torn == 0);
+  CHECK(latest.load().fields[0] == 100000);
+}
+
+TEST_CASE("latest_value: triple_buffer")
+{
+  plz::triple_buffer<std::string> latest;
+
+  CHECK(latest.read().empty());
+  CHECK_FALSE(latest.has_update());
+
+  latest.publish("a");
+  latest.publish("b");
+  CHECK(latest.has_update());
+  CHECK(latest.read() == "b");
+  CHECK_FALSE(latest.has_update());
+  CHECK(latest.read() == "b");
+
+  latest.publish(std::string("c"));
+  CHECK(latest.read() == "c");
+}
+
+TEST_CASE("latest_value: triple_buffer reader never sees torn values")
+{
+  plz::triple_buffer<snapshot> latest;
+  std::atomic<bool> done{ false };
+  size_t torn = 0;
+
+  std::thread reader(
+    [&]
+    {
+      uint64_t previous = 0;
+      while(!done)
+      {
+        auto& value = latest.read();
+        if(!value.is_consistent() || value.fields[0] < previous)
+        {
+          torn++;
+        }
+        previous = value.fields[0];
+      }
+    });
+
+  for(uint64_t i = 1; i <= 100000; ++i)
+  {
+    latest.publish(snapshot(i));
+  }
+  done = true;
+  reader.join();
+
+  CHECK(torn == 0);
+  CHECK(latest.read().fields[0] == 100000);
+}
@@ -0,0 +1,146 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include <plz/parallel_region.hpp>
+
+TEST_CASE("parallel_region: iterative stencil with barriers")
+{
+  plz::thread_pool pool(3);
+
+  const size_t size = 1000;
+  std::vector<double> current(size, 0.0);
+  std::vector<double> next(size, 0.0);
+  current.front() = next.front() = 1.0;
+
+  std::vector<double> expected_current = current;
+  std::vector<double> expected_next    = next;
+
+  for(int step = 0; step < 50; ++step)
+  {
+    for(size_t i = 1; i < size - 1; ++i)
+    {
+      expected_next[i] = (expected_current[i - 1] + expected_current[i + 1]) / 2;
+    }
+    std::swap(expected_current, expected_next);
+  }
+
+  std::atomic<size_t> members{ 0 };
+  std::atomic<int> master_calls{ 0 };
+
+  plz::parallel_region(pool,
+    4,
+    [&](plz::team_context& team)
+    {
+      ++members;
+      CHECK(team.team_size() == 4);
+
+      for(int step = 0; step < 50; ++step)
+      {
+        team.for_static(1,
+          size - 1,
+          [&](size_t i)
+          {
+            next[i] = (current[i - 1] + current[i + 1]) / 2;
+          });
+
+        team.single(
+          [&]
+          {
+            std::swap(current, next);
+          });
+      }
+
+      team.master(
+        [&]
+        {
+          ++master_calls;
+        });
+    });
+
+  CHECK(members == 4);
+  CHECK(master_calls == 1);
+  CHECK(current == expected_current);
+}
+
+TEST_CASE("parallel_region: static ranges cover the loop")
+{
+  plz::thread_pool pool(2);
+
+  std::vector<int> hits(101, 0);
+
+  plz::parallel_region(pool,
+    3,
+    [&](plz::team_context& team)
+    {
+      auto [first, last] = team.static_range(0, hits.size());
+      for(auto i = first; i < last; ++i)
+      {
+        hits[i]++;
+      }
+      team.barrier();
+    });
+
+  CHECK(hits == std::vector<int>(101, 1));
+}
+
+TEST_CASE("parallel_region: a failing member unwinds the team")
+{
+  plz::thread_pool pool(2);
+
+  CHECK_THROWS_AS(plz::parallel_region(pool,
+                    3,
+                    [](plz::team_context& team)
+                    {
+                      if(team.thread_index() == 1)
+                      {
+                        throw std::runtime_error("member failed");
+                      }
+
+                      team.barrier();
+                    }),
+    std::runtime_error);
+}
+
+TEST_CASE("parallel_region: members do not wait for a busy worker")
+{
+  plz::thread_pool pool(2);
+
+  auto started = plz::make_promise<void>();
+  auto gate    = plz::make_promise<void>();
+
+  pool.run(
+    [started, future = gate.get_future()]() mutable
+    {
+      started.set_ready();
+      future.get();
+    });
+
+  started.get_future().get();
+
+  // the member spawned for the blocked worker would never reach the barrier
+  std::atomic<size_t> team_size{ 0 };
+  auto region = pool.run(
+    [&pool, &team_size]
+    {
+      plz::parallel_region(pool,
+        2,
+        [&team_size](plz::team_context& team)
+        {
+          team.barrier();
+          team.master(
+            [&]
+            {
+              team_size = team.team_size();
+            });
+          team.barrier();
+        });
+    });
+
+  region.get();
+  CHECK(team_size == 1);
+
+  gate.set_ready();
+}
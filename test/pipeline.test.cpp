@@ -0,0 +1,124 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "plz/circbuff/pipeline.hpp"
+
+TEST_CASE("pipeline: drain runs the values through the stages")
+{
+  auto [source, sink] = plz::make_channel(std::make_shared<std::array<int, 16>>());
+
+  std::vector<int> values;
+  auto flow = sink | plz::stage(
+                       [](int value)
+                       {
+                         return value * 3;
+                       }) |
+    plz::filter(
+      [](int value)
+      {
+        return value % 2 == 0;
+      }) |
+    plz::into(
+      [&values](int value)
+      {
+        values.push_back(value);
+      });
+
+  for(int i = 0; i < 6; ++i)
+  {
+    source.put(i);
+  }
+
+  CHECK(flow.drain() == 6);
+  CHECK(values == std::vector<int>{ 0, 6, 12 });
+  CHECK(sink.get_available_data_size() == 0);
+}
+
+TEST_CASE("pipeline: stages may change the value type")
+{
+  auto [source, sink] = plz::make_channel(std::make_shared<std::array<int, 16>>());
+
+  std::string text;
+  auto flow = sink | plz::stage(
+                       [](int value)
+                       {
+                         return std::to_string(value);
+                       }) |
+    plz::into(
+      [&text](const std::string& value)
+      {
+        text += value;
+      });
+
+  flow.push(4);
+  source.put(2);
+  flow.drain();
+
+  CHECK(text == "42");
+}
+
+TEST_CASE("pipeline: connected pipeline follows the writes across the ring end")
+{
+  auto [source, sink] = plz::make_channel(std::make_shared<std::array<int, 16>>());
+
+  std::vector<int> values;
+  auto flow = sink | plz::stage(
+                       [](int value)
+                       {
+                         return value + 1;
+                       }) |
+    plz::into(
+      [&values](int value)
+      {
+        values.push_back(value);
+      });
+
+  auto connection = plz::connect(&source, &flow);
+
+  std::array<int, 12> input;
+  std::iota(input.begin(), input.end(), 0);
+
+  source.write(input.data(), input.size());
+  source.write(input.data(), input.size());
+
+  std::vector<int> expected;
+  for(int round = 0; round < 2; ++round)
+  {
+    for(auto value : input)
+    {
+      expected.push_back(value + 1);
+    }
+  }
+
+  CHECK(values == expected);
+
+  plz::disconnect(&source, connection);
+  source.put(0);
+  CHECK(values.size() == expected.size());
+}
+
+TEST_CASE("pipeline: into_source feeds another channel")
+{
+  auto [source, sink]         = plz::make_channel(std::make_shared<std::array<int, 16>>());
+  auto [out_source, out_sink] = plz::make_channel(std::make_shared<std::array<int, 16>>());
+
+  auto flow = sink | plz::filter(
+                       [](int value)
+                       {
+                         return value > 2;
+                       }) |
+    plz::into_source(out_source);
+
+  for(int i = 0; i < 5; ++i)
+  {
+    source.put(i);
+  }
+  flow.drain();
+
+  CHECK(out_sink.read_all() == std::vector<int>{ 3, 4 });
+}
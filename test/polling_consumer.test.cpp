@@ -0,0 +1,101 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "plz/circbuff/polling_consumer.hpp"
+
+using namespace std::chrono_literals;
+
+static void wait_for_reads(const auto& consumer, size_t count)
+{
+  auto deadline = std::chrono::steady_clock::now() + 5s;
+  while(consumer.get_read_count() < count && std::chrono::steady_clock::now() < deadline)
+  {
+    std::this_thread::sleep_for(1ms);
+  }
+}
+
+TEST_CASE("polling_consumer: handles the values as they are written")
+{
+  auto [source, sink] = plz::make_channel(std::make_shared<std::array<int, 1024>>());
+
+  std::vector<int> values;
+  plz::polling_consumer consumer(sink,
+    [&values](int* data, size_t count)
+    {
+      values.insert(values.end(), data, data + count);
+      return count;
+    });
+
+  for(int i = 0; i < 500; ++i)
+  {
+    source.put(i);
+  }
+
+  wait_for_reads(consumer, 500);
+  consumer.stop();
+
+  std::vector<int> expected(500);
+  std::iota(expected.begin(), expected.end(), 0);
+  CHECK(values == expected);
+}
+
+TEST_CASE("polling_consumer: adaptive back-off and pinning")
+{
+  auto [source, sink] = plz::make_channel(std::make_shared<std::array<int, 64>>());
+
+  // a cpu this process is allowed to run on
+  std::optional<size_t> cpu;
+#if defined(__linux__)
+  cpu = static_cast<size_t>(sched_getcpu());
+#endif
+
+  std::atomic<int> total{ 0 };
+  plz::polling_consumer consumer(sink,
+    [&total](int* data, size_t count)
+    {
+      for(size_t i = 0; i < count; ++i)
+      {
+        total += data[i];
+      }
+      return count;
+    },
+    plz::polling_options{ .cpu = cpu, .idle_spins = 100, .max_idle_sleep = 100us, .batch_size = 8 });
+
+#if defined(__linux__)
+  CHECK(consumer.is_pinned());
+#endif
+
+  // the consumer went to sleep in the meantime and still picks the values up
+  std::this_thread::sleep_for(20ms);
+  for(int i = 1; i <= 10; ++i)
+  {
+    source.put(i);
+  }
+
+  wait_for_reads(consumer, 10);
+  CHECK(total == 55);
+}
+
+#if defined(__linux__)
+TEST_CASE("polling_consumer: rejects a cpu out of the cpu set")
+{
+  auto [source, sink] = plz::make_channel(std::make_shared<std::array<int, 64>>());
+
+  auto handler = [](int*, size_t count)
+  {
+    return count;
+  };
+
+  CHECK_THROWS_AS(plz::polling_consumer(sink, handler, plz::polling_options{ .cpu = CPU_SETSIZE }),
+    std::invalid_argument);
+}
+#endif
@@ -0,0 +1,82 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "plz/circbuff/priority_channel.hpp"
+
+using namespace std::chrono_literals;
+
+using buffer_ptr = std::shared_ptr<std::array<int, 16>>;
+
+static buffer_ptr make_buffer()
+{
+  return std::make_shared<std::array<int, 16>>();
+}
+
+TEST_CASE("priority_channel: higher levels are read first")
+{
+  plz::priority_channel<buffer_ptr, 3> channel(make_buffer);
+
+  channel.put(2, 20);
+  channel.put(2, 21);
+  channel.put(1, 10);
+  channel.put(0, 0);
+  channel.put(1, 11);
+
+  CHECK(channel.get_available_data_size() == 5);
+  CHECK(channel.get_available_data_size(1) == 2);
+  CHECK(channel.try_get() == 0);
+  CHECK(channel.read(10) == std::vector<int>{ 10, 11, 20, 21 });
+  CHECK_FALSE(channel.try_get().has_value());
+
+  CHECK_THROWS_AS(channel.put(3, 0), std::out_of_range);
+}
+
+TEST_CASE("priority_channel: per level capacity and drop policy")
+{
+  plz::priority_channel<buffer_ptr, 2> channel(make_buffer,
+    { plz::priority_level_options{ 2, plz::drop_policy::drop_newest },
+      plz::priority_level_options{ 3, plz::drop_policy::overwrite_oldest } });
+
+  CHECK(channel.put(0, 1));
+  CHECK(channel.put(0, 2));
+  CHECK_FALSE(channel.put(0, 3));
+
+  for(int i = 10; i < 15; ++i)
+  {
+    CHECK(channel.put(1, i));
+  }
+
+  CHECK(channel.get_dropped_count(0) == 1);
+  CHECK(channel.get_dropped_count(1) == 2);
+  CHECK(channel.get_available_data_size() == 5);
+  CHECK(channel.read(10) == std::vector<int>{ 1, 2, 12, 13, 14 });
+
+  CHECK_THROWS_AS((plz::priority_channel<buffer_ptr, 1>(make_buffer, { plz::priority_level_options{ 17 } })),
+    std::invalid_argument);
+}
+
+TEST_CASE("priority_channel: a write to any level wakes the consumer")
+{
+  plz::priority_channel<buffer_ptr, 2> channel(make_buffer);
+
+  CHECK_FALSE(channel.get(10ms).has_value());
+
+  for(size_t level = 0; level < 2; ++level)
+  {
+    std::thread producer(
+      [&channel, level]
+      {
+        std::this_thread::sleep_for(10ms);
+        channel.put(level, static_cast<int>(level) + 1);
+      });
+
+    CHECK(channel.get(5s) == static_cast<int>(level) + 1);
+    producer.join();
+  }
+}
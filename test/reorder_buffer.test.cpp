@@ -0,0 +1,117 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "plz/circbuff/reorder_buffer.hpp"
+#include "plz/thread_pool.hpp"
+
+using buffer_ptr = std::shared_ptr<std::array<int, 1024>>;
+
+TEST_CASE("reorder_buffer: emits in sequence order")
+{
+  auto [source, sink] = plz::make_channel(std::make_shared<std::array<int, 1024>>());
+
+  plz::reorder_buffer ordered(source, 4);
+
+  CHECK(ordered.try_push(2, 20));
+  CHECK(ordered.try_push(1, 10));
+  CHECK(sink.get_available_data_size() == 0);
+  CHECK(ordered.get_pending_count() == 2);
+
+  // outside of the window [0, 4)
+  CHECK_FALSE(ordered.try_push(4, 40));
+
+  CHECK(ordered.try_push(0, 0));
+  CHECK(sink.read_all() == std::vector<int>{ 0, 10, 20 });
+  CHECK(ordered.get_next_sequence() == 3);
+  CHECK(ordered.get_pending_count() == 0);
+
+  CHECK_THROWS_AS(ordered.try_push(1, 10), std::invalid_argument);
+}
+
+TEST_CASE("reorder_buffer: holds the results while the output is full")
+{
+  auto [source, sink] = plz::make_channel(std::make_shared<std::array<int, 4>>());
+
+  plz::reorder_buffer ordered(source, 8);
+
+  for(int i = 0; i < 8; ++i)
+  {
+    CHECK(ordered.try_push(i, i));
+  }
+
+  // nothing overwritten, the window is full of held results
+  CHECK(sink.get_available_data_size() == 4);
+  CHECK(ordered.get_pending_count() == 4);
+  CHECK(ordered.get_next_sequence() == 4);
+  CHECK_FALSE(ordered.try_push(12, 12));
+
+  // reading makes room, the held results follow
+  CHECK(sink.read(2) == std::vector<int>{ 0, 1 });
+  CHECK(ordered.get_pending_count() == 2);
+  CHECK(sink.read_all() == std::vector<int>{ 2, 3, 4, 5 });
+  CHECK(sink.read_all() == std::vector<int>{ 6, 7 });
+  CHECK(ordered.get_pending_count() == 0);
+}
+
+TEST_CASE("reorder_buffer: parallel workers with backpressure")
+{
+  auto [source, sink] = plz::make_channel(std::make_shared<std::array<int, 1024>>());
+
+  plz::reorder_buffer ordered(source, 8);
+  plz::thread_pool pool(4);
+
+  for(int i = 0; i < 1000; ++i)
+  {
+    pool.run(
+      [&ordered](int i)
+      {
+        thread_local std::mt19937 random(std::random_device{}());
+        std::this_thread::sleep_for(std::chrono::microseconds(random() % 100));
+
+        ordered.push(i, i * 2);
+
+        // the fast workers waited instead of filling the buffer
+        CHECK(ordered.get_pending_count() <= 8);
+      },
+      i);
+  }
+  pool.wait();
+
+  std::vector<int> values;
+  while(sink.get_available_data_size() > 0)
+  {
+    auto batch = sink.read_all();
+    values.insert(values.end(), batch.begin(), batch.end());
+  }
+
+  REQUIRE(values.size() == 1000);
+  for(int i = 0; i < 1000; ++i)
+  {
+    CHECK(values[i] == i * 2);
+  }
+}
+
+TEST_CASE("reorder_buffer: discards the pending results")
+{
+  auto [source, sink] = plz::make_channel(std::make_shared<std::array<int, 1024>>());
+
+  plz::reorder_buffer ordered(source, 4);
+
+  CHECK(ordered.try_push(1, 10));
+  CHECK(ordered.try_push(3, 30));
+  CHECK(ordered.discard_pending() == 2);
+  CHECK(ordered.get_pending_count() == 0);
+
+  // still waiting for 0, and 1 may come again
+  CHECK(ordered.try_push(0, 0));
+  CHECK(ordered.try_push(1, 11));
+  CHECK(sink.read_all() == std::vector<int>{ 0, 11 });
+  CHECK(ordered.get_next_sequence() == 2);
+}
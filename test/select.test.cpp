@@ -0,0 +1,93 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "plz/circbuff/select.hpp"
+
+using namespace std::chrono_literals;
+
+TEST_CASE("select: returns the sink that has data")
+{
+  auto [int_source, int_sink]     = plz::make_channel(std::make_shared<std::array<int, 16>>());
+  auto [float_source, float_sink] = plz::make_channel(std::make_shared<std::array<float, 16>>());
+  auto [other_source, other_sink] = plz::make_channel(std::make_shared<std::array<int, 16>>());
+
+  float_source.put(1.5f);
+  CHECK(plz::select(10ms, int_sink, float_sink, other_sink) == 1);
+
+  float_sink.get();
+  other_source.put(3);
+  CHECK(plz::select(int_sink, float_sink, other_sink) == 2);
+}
+
+TEST_CASE("select: times out when no sink has data")
+{
+  auto [source_a, sink_a] = plz::make_channel(std::make_shared<std::array<int, 16>>());
+  auto [source_b, sink_b] = plz::make_channel(std::make_shared<std::array<int, 16>>());
+
+  auto start = std::chrono::steady_clock::now();
+  CHECK_FALSE(plz::select(20ms, sink_a, sink_b).has_value());
+  CHECK(std::chrono::steady_clock::now() - start >= 20ms);
+}
+
+TEST_CASE("select: wakes up when a source writes or closes")
+{
+  auto [source_a, sink_a] = plz::make_channel(std::make_shared<std::array<int, 16>>());
+  auto [source_b, sink_b] = plz::make_channel(std::make_shared<std::array<int, 16>>());
+
+  std::thread writer(
+    [&source_b]
+    {
+      std::this_thread::sleep_for(10ms);
+      source_b.put(42);
+    });
+
+  CHECK(plz::select(5s, sink_a, sink_b) == 1);
+  CHECK(sink_b.get() == 42);
+  writer.join();
+
+  std::thread closer(
+    [&source_a]
+    {
+      std::this_thread::sleep_for(10ms);
+      source_a.close();
+    });
+
+  CHECK(plz::select(5s, sink_a, sink_b) == 0);
+  CHECK(sink_a.is_closed());
+  closer.join();
+}
+
+TEST_CASE("select: over a runtime number of sinks")
+{
+  using buffer_ptr = std::shared_ptr<std::array<int, 16>>;
+
+  std::vector<plz::source<buffer_ptr>> sources;
+  std::vector<plz::sink<buffer_ptr>> sinks;
+  for(int i = 0; i < 24; ++i)
+  {
+    auto [source, sink] = plz::make_channel(std::make_shared<std::array<int, 16>>());
+    sources.push_back(std::move(source));
+    sinks.push_back(std::move(sink));
+  }
+
+  std::thread writer(
+    [&sources]
+    {
+      std::this_thread::sleep_for(10ms);
+      sources[17].put(17);
+    });
+
+  auto ready = plz::select(5s, std::span(sinks));
+  REQUIRE(ready == 17u);
+  CHECK(sinks[*ready].get() == 17);
+  writer.join();
+
+  // all drained again
+  CHECK_FALSE(plz::select(10ms, std::span(sinks)).has_value());
+}
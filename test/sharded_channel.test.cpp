@@ -0,0 +1,173 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "plz/circbuff/sharded_channel.hpp"
+
+using buffer_ptr = std::shared_ptr<std::array<int, 1024>>;
+
+static buffer_ptr make_buffer()
+{
+  return std::make_shared<std::array<int, 1024>>();
+}
+
+TEST_CASE("sharded_channel: one shard per producer thread")
+{
+  plz::sharded_channel channel(make_buffer);
+
+  std::vector<std::thread> producers;
+  for(int p = 0; p < 4; ++p)
+  {
+    producers.emplace_back(
+      [&channel, p]
+      {
+        for(int i = 0; i < 100; ++i)
+        {
+          channel.put(p * 1000 + i);
+        }
+      });
+  }
+
+  for(auto& producer : producers)
+  {
+    producer.join();
+  }
+
+  CHECK(channel.get_shard_count() == 4);
+  CHECK(channel.get_available_data_size() == 400);
+
+  auto values = channel.read();
+  REQUIRE(values.size() == 400);
+
+  // every producer's values come out in the order they were written
+  for(int p = 0; p < 4; ++p)
+  {
+    std::vector<int> from_producer;
+    std::copy_if(values.begin(),
+      values.end(),
+      std::back_inserter(from_producer),
+      [p](int value)
+      {
+        return value / 1000 == p;
+      });
+
+    REQUIRE(from_producer.size() == 100);
+    CHECK(std::is_sorted(from_producer.begin(), from_producer.end()));
+  }
+}
+
+TEST_CASE("sharded_channel: the same thread reuses its shard")
+{
+  plz::sharded_channel channel(make_buffer);
+
+  channel.put(1);
+  channel.put(2);
+  CHECK(&channel.local_source() == &channel.local_source());
+  CHECK(channel.get_shard_count() == 1);
+  CHECK(channel.read() == std::vector<int>{ 1, 2 });
+}
+
+TEST_CASE("sharded_channel: batches are drained fairly")
+{
+  plz::sharded_channel channel(make_buffer);
+
+  std::thread first(
+    [&channel]
+    {
+      for(int i = 0; i < 10; ++i)
+      {
+        channel.put(i);
+      }
+    });
+  first.join();
+
+  std::thread second(
+    [&channel]
+    {
+      for(int i = 100; i < 110; ++i)
+      {
+        channel.put(i);
+      }
+    });
+  second.join();
+
+  // a batch takes at most 3 values of each shard
+  auto batch = channel.read(3);
+  CHECK(batch.size() == 6);
+  CHECK(std::count_if(batch.begin(),
+          batch.end(),
+          [](int value)
+          {
+            return value >= 100;
+          }) == 3);
+  CHECK(channel.get_available_data_size() == 14);
+}
+
+TEST_CASE("sharded_channel: read_merged orders the values by key")
+{
+  plz::sharded_channel channel(make_buffer);
+
+  auto produce = [&channel](int first)
+  {
+    for(int i = first; i < 60; i += 3)
+    {
+      channel.put(i);
+    }
+  };
+
+  std::thread a(produce, 0);
+  std::thread b(produce, 1);
+  std::thread c(produce, 2);
+  a.join();
+  b.join();
+  c.join();
+
+  auto values = channel.read_merged(
+    [](int value)
+    {
+      return value;
+    });
+
+  std::vector<int> expected(60);
+  std::iota(expected.begin(), expected.end(), 0);
+  CHECK(values == expected);
+}
+
+TEST_CASE("sharded_channel: max_shards bounds the producer threads")
+{
+  plz::sharded_channel channel(make_buffer, 1);
+
+  channel.put(1);
+
+  std::thread other(
+    [&channel]
+    {
+      CHECK_THROWS_AS(channel.put(2), std::runtime_error);
+    });
+  other.join();
+}
+
+TEST_CASE("sharded_channel: the drained shard of an exited thread is recycled")
+{
+  plz::sharded_channel channel(make_buffer, 1);
+
+  for(int p = 0; p < 3; ++p)
+  {
+    std::thread producer(
+      [&channel, p]
+      {
+        channel.put(p);
+      });
+    producer.join();
+
+    CHECK(channel.read() == std::vector<int>{ p });
+  }
+
+  CHECK(channel.get_shard_count() == 1);
+}
@@ -0,0 +1,174 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "plz/circbuff/channel.hpp"
+#include "plz/circbuff/slab.hpp"
+
+static std::atomic<int> g_live_payloads{ 0 };
+
+struct payload
+{
+  explicit payload(int id) : id{ id }, data(1024, id)
+  {
+    g_live_payloads++;
+  }
+
+  ~payload()
+  {
+    g_live_payloads--;
+  }
+
+  int id;
+  std::vector<int> data;
+};
+
+TEST_CASE("slab: the last release frees the slot")
+{
+  plz::slab<payload> payloads(2);
+
+  auto first = payloads.try_emplace(2, 1);
+  REQUIRE(first);
+  CHECK(payloads[*first].data[10] == 1);
+  CHECK(payloads.get_free_count() == 1);
+
+  auto second = payloads.try_emplace(1, 2);
+  REQUIRE(second);
+  CHECK_FALSE(payloads.try_emplace(1, 3).has_value());
+
+  payloads.release(*first);
+  CHECK(payloads.get_free_count() == 0);
+  payloads.release(*first);
+  CHECK(payloads.get_free_count() == 1);
+  CHECK(g_live_payloads == 1);
+
+  payloads.retain(*second);
+  payloads.release(*second);
+  CHECK(g_live_payloads == 1);
+
+  // the slot of the destroyed payload is reused
+  auto third = payloads.try_emplace(1, 3);
+  REQUIRE(third);
+  CHECK(third->index == first->index);
+
+  CHECK_THROWS_AS(plz::slab<payload>(0), std::invalid_argument);
+}
+
+TEST_CASE("slab: handles broadcast to the sinks of an spmc channel")
+{
+  constexpr int SINKS    = 3;
+  constexpr int MESSAGES = 20000;
+
+  {
+    plz::slab<payload> payloads(64);
+    auto [source, sinks] =
+      plz::make_spmc_channel<SINKS>(std::make_shared<std::array<plz::slab_handle, 64>>());
+
+    std::atomic<int> corrupted{ 0 };
+    std::vector<std::thread> readers;
+
+    for(auto& sink : sinks)
+    {
+      readers.emplace_back(
+        [&payloads, &corrupted, &sink]
+        {
+          for(int received = 0; received < MESSAGES;)
+          {
+            if(sink.get_available_data_size() == 0)
+            {
+              std::this_thread::yield();
+              continue;
+            }
+
+            auto handle = sink.get();
+            auto& value = payloads[handle];
+            if(value.id != received || value.data.back() != received)
+            {
+              corrupted++;
+            }
+
+            payloads.release(handle);
+            received++;
+          }
+        });
+    }
+
+    for(int i = 0; i < MESSAGES; ++i)
+    {
+      std::optional<plz::slab_handle> handle;
+
+      // the slab holds less slots than the ring, so a full slab also keeps
+      // the writer from overwriting unread handles
+      while(!(handle = payloads.try_emplace(SINKS, i)))
+      {
+        std::this_thread::yield();
+      }
+
+      source.put(*handle);
+    }
+
+    for(auto& reader : readers)
+    {
+      reader.join();
+    }
+
+    CHECK(corrupted == 0);
+    CHECK(payloads.get_free_count() == 64);
+  }
+
+  CHECK(g_live_payloads == 0);
+}
+
+TEST_CASE("slab: a slab channel releases the values every sink read")
+{
+  {
+    plz::slab<payload> payloads(8);
+    auto [source, sinks] =
+      plz::make_slab_channel<2>(payloads, std::make_shared<std::array<plz::slab_handle, 4>>());
+
+    for(int i = 0; i < 4; ++i)
+    {
+      CHECK(source.try_publish(i));
+    }
+
+    // the handles that the second sink did not read are not overwritten
+    CHECK_FALSE(source.try_publish(4));
+    CHECK(payloads.get_free_count() == 4);
+
+    std::optional<plz::slab_ref<payload>> kept;
+    for(int i = 0; i < 4; ++i)
+    {
+      auto value = sinks[0].try_get();
+      REQUIRE(value);
+      CHECK((*value)->id == i);
+      if(i == 0)
+      {
+        kept = value;
+      }
+    }
+    CHECK_FALSE(sinks[0].try_get().has_value());
+    CHECK_FALSE(source.try_publish(4));
+
+    {
+      // the moved-to sink is destroyed without reading, nothing holds the
+      // ring back anymore
+      auto lagging = std::move(sinks[1]);
+    }
+
+    CHECK(source.try_publish(4));
+    CHECK(payloads.get_free_count() == 6);
+    CHECK((*kept)->id == 0);
+
+    kept.reset();
+    CHECK(payloads.get_free_count() == 7);
+    CHECK(sinks[0].try_get().value()->id == 4);
+  }
+
+  CHECK(g_live_payloads == 0);
+}
@@ -0,0 +1,140 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "plz/circbuff/window.hpp"
+
+using int_buffer_ptr  = std::shared_ptr<std::array<int, 64>>;
+using size_buffer_ptr = std::shared_ptr<std::array<size_t, 64>>;
+
+TEST_CASE("window: tumbling window")
+{
+  auto [source, sink]         = plz::make_channel(std::make_shared<std::array<int, 64>>());
+  auto [out_source, out_sink] = plz::make_channel(std::make_shared<std::array<int, 64>>());
+
+  plz::tumbling_window<plz::aggregate::sum<int>, int_buffer_ptr> window(3, out_source);
+
+  for(int i = 1; i <= 8; ++i)
+  {
+    source.put(i);
+  }
+
+  CHECK(window.drain(sink) == 8);
+  CHECK(out_sink.read_all() == std::vector<int>{ 6, 15 });
+
+  window.flush();
+  CHECK(out_sink.read_all() == std::vector<int>{ 15 });
+}
+
+TEST_CASE("window: sliding window with an invertible aggregator")
+{
+  auto [source, sink]         = plz::make_channel(std::make_shared<std::array<int, 64>>());
+  auto [out_source, out_sink] = plz::make_channel(std::make_shared<std::array<int, 64>>());
+
+  plz::sliding_window<plz::aggregate::sum<int>, int_buffer_ptr> window(3, out_source);
+
+  for(int i = 1; i <= 6; ++i)
+  {
+    source.put(i);
+  }
+
+  window.drain(sink);
+  CHECK(out_sink.read_all() == std::vector<int>{ 6, 9, 12, 15 });
+}
+
+TEST_CASE("window: sliding min and max use partial aggregates")
+{
+  auto [source, sink]         = plz::make_channel(std::make_shared<std::array<int, 64>>());
+  auto [min_source, min_sink] = plz::make_channel(std::make_shared<std::array<int, 64>>());
+  auto [max_source, max_sink] = plz::make_channel(std::make_shared<std::array<int, 64>>());
+
+  plz::sliding_window<plz::aggregate::min<int>, int_buffer_ptr> minimum(3, min_source);
+  plz::sliding_window<plz::aggregate::max<int>, int_buffer_ptr> maximum(3, max_source, 2);
+
+  const std::vector<int> values{ 5, 1, 4, 7, 2, 8, 3, 6 };
+  for(auto value : values)
+  {
+    minimum.push(value);
+    maximum.push(value);
+  }
+
+  CHECK(min_sink.read_all() == std::vector<int>{ 1, 1, 2, 2, 2, 3 });
+
+  // every second window: {5,1,4} {4,7,2} {2,8,3}
+  CHECK(max_sink.read_all() == std::vector<int>{ 5, 7, 8 });
+}
+
+// decimal digits appended in order, a non commutative monoid
+struct digits
+{
+  int value;
+  int scale;
+};
+
+TEST_CASE("window: sliding window with a non commutative reducer")
+{
+  using digits_buffer_ptr = std::shared_ptr<std::array<digits, 16>>;
+
+  auto [out_source, out_sink] = plz::make_channel(std::make_shared<std::array<digits, 16>>());
+
+  auto concat = plz::aggregate::reduce<int>(
+    digits{ 0, 1 },
+    [](int value)
+    {
+      return digits{ value, 10 };
+    },
+    [](const digits& older, const digits& newer)
+    {
+      return digits{ older.value * newer.scale + newer.value, older.scale * newer.scale };
+    });
+
+  plz::sliding_window<decltype(concat), digits_buffer_ptr> window(3, out_source, 1, concat);
+
+  for(int i = 1; i <= 5; ++i)
+  {
+    window.push(i);
+  }
+
+  std::vector<int> values;
+  for(auto& result : out_sink.read_all())
+  {
+    values.push_back(result.value);
+  }
+
+  CHECK(values == std::vector<int>{ 123, 234, 345 });
+}
+
+struct event
+{
+  int time;
+};
+
+struct time_of_event
+{
+  int operator()(const event& value) const
+  {
+    return value.time;
+  }
+};
+
+TEST_CASE("window: session window")
+{
+  auto [source, sink]         = plz::make_channel(std::make_shared<std::array<event, 64>>());
+  auto [out_source, out_sink] = plz::make_channel(std::make_shared<std::array<size_t, 64>>());
+
+  plz::session_window<plz::aggregate::count<event>, size_buffer_ptr, time_of_event> sessions(
+    10, out_source);
+
+  for(int time : { 0, 5, 12, 40, 45, 100 })
+  {
+    source.put(event{ time });
+  }
+
+  sessions.drain(sink);
+  CHECK(out_sink.read_all() == std::vector<size_t>{ 3, 2 });
+
+  sessions.flush();
+  CHECK(out_sink.read_all() == std::vector<size_t>{ 1 });
+}
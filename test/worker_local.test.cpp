@@ -0,0 +1,63 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include <plz/worker_local.hpp>
+
+TEST_CASE("worker_local: per worker accumulators")
+{
+  plz::thread_pool pool(4);
+
+  plz::worker_local<uint64_t> sums(pool, 0);
+  plz::worker_local<std::vector<int>> scratch(pool);
+
+  std::vector<int> values(1000);
+  std::iota(values.begin(), values.end(), 1);
+
+  pool.map(values,
+    [&](int value)
+    {
+      // the buffer of the worker is reused from task to task
+      auto& buffer = scratch.local();
+      buffer.assign(value % 10, value);
+
+      sums.local() += value;
+      return value;
+    });
+  pool.wait();
+
+  CHECK(sums.size() == 4);
+  CHECK(sums.combine(std::plus<>{}) == 500500);
+
+  size_t reused = 0;
+  scratch.for_each(
+    [&](std::vector<int>& buffer)
+    {
+      reused += buffer.capacity() > 0 ? 1 : 0;
+    });
+  CHECK(reused > 0);
+}
+
+TEST_CASE("worker_local: instances do not share cache lines")
+{
+  plz::thread_pool pool(2);
+  plz::worker_local<char> flags(pool, 0);
+
+  auto first  = reinterpret_cast<uintptr_t>(&flags[0]);
+  auto second = reinterpret_cast<uintptr_t>(&flags[1]);
+
+  CHECK(first % 64 == 0);
+  CHECK(second - first >= 64);
+}
+
+TEST_CASE("worker_local: access outside of the pool throws")
+{
+  plz::thread_pool pool(2);
+  plz::worker_local<int> values(pool);
+
+  CHECK_THROWS_AS(values.local(), std::runtime_error);
+}